@@ -0,0 +1,344 @@
+#include "accounts.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static int table_fd = -1;
+static AccountTable* table_mapped = NULL;   // Herdado pelos filhos do controller
+static size_t table_bytes = 0;
+
+static uint32_t bucket_count(int accounts) {
+    // Buckets no máximo meio cheios: a sonda raramente passa do primeiro
+    uint64_t needed = ((uint64_t)accounts * 2 + ACCOUNT_BUCKET_SLOTS - 1) / ACCOUNT_BUCKET_SLOTS;
+    uint32_t buckets = 1;
+    while (buckets < needed) {
+        buckets <<= 1;
+    }
+    return buckets;
+}
+
+size_t account_table_size(int accounts) {
+    return sizeof(AccountTable) + (size_t)bucket_count(accounts) * sizeof(AccountBucket);
+}
+
+void account_table_init(AccountTable* table, int accounts, int64_t initial_balance) {
+    uint32_t buckets = bucket_count(accounts);
+    memcpy(table->magic, ACCOUNT_TABLE_MAGIC, sizeof(table->magic));
+    table->version = ACCOUNT_TABLE_VERSION;
+    table->clean = 0;
+    table->bucket_mask = buckets - 1;
+    table->max_accounts = (uint32_t)accounts;
+    table->initial_balance = initial_balance;
+    atomic_store(&table->accounts, 0);
+    atomic_store(&table->applied_height, 0);
+    atomic_store(&table->journal_count, 0);
+    atomic_store(&table->journal_height, 0);
+
+    for (uint32_t b = 0; b < buckets; b++) {
+        for (int s = 0; s < ACCOUNT_BUCKET_SLOTS; s++) {
+            atomic_store_explicit(&table->buckets[b].ids[s], ACCOUNT_EMPTY, memory_order_relaxed);
+            atomic_store_explicit(&table->buckets[b].balances[s], 0, memory_order_relaxed);
+        }
+    }
+}
+
+static inline AccountUndo* journal_entries(AccountTable* table) {
+    return (AccountUndo*)((char*)table + table->journal_offset);
+}
+
+// Muda a cada arranque da máquina: o page cache de um arranque anterior pode ter-se perdido
+static void read_boot_id(char boot_id[ACCOUNT_BOOT_ID_LEN]) {
+    memset(boot_id, 0, ACCOUNT_BOOT_ID_LEN);
+    FILE* f = fopen("/proc/sys/kernel/random/boot_id", "r");
+    if (f != NULL) {
+        if (fgets(boot_id, ACCOUNT_BOOT_ID_LEN, f) != NULL) {
+            boot_id[strcspn(boot_id, "\n")] = '\0';
+        }
+        fclose(f);
+    }
+}
+
+static void recount_accounts(AccountTable* table) {
+    uint64_t accounts = 0;
+    for (uint32_t b = 0; b <= table->bucket_mask; b++) {
+        for (int s = 0; s < ACCOUNT_BUCKET_SLOTS; s++) {
+            accounts += atomic_load_explicit(&table->buckets[b].ids[s], memory_order_relaxed) != ACCOUNT_EMPTY;
+        }
+    }
+    atomic_store(&table->accounts, accounts);
+}
+
+// Desfaz o bloco que estava a ser aplicado quando o processo morreu. Uma entrada desfeita
+// duas vezes (morte a meio do rollback) só repete stores; o contador de contas é refeito
+static int recover_journal(AccountTable* table) {
+    int count = atomic_load(&table->journal_count);
+    if (count <= 0 || atomic_load(&table->journal_height) != atomic_load(&table->applied_height)) {
+        return 0;
+    }
+    AccountBatch batch = {
+        .entries = journal_entries(table), .count = count, .capacity = table->journal_capacity,
+        .failed_tx = -1, .journal = table,
+    };
+    account_rollback(table, &batch);
+    recount_accounts(table);
+    return count;
+}
+
+AccountTable* account_table_open(const char* path, Config* config, uint64_t chain_height) {
+    table_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (table_fd == -1) {
+        log_message("ERROR: Failed to open %s: %s", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    AccountTable header;
+    int known = pread(table_fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                memcmp(header.magic, ACCOUNT_TABLE_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version == ACCOUNT_TABLE_VERSION;
+    if (known && ((int)header.max_accounts != config->account_table_size ||
+                  header.initial_balance != config->account_initial_balance)) {
+        log_message("WARNING: %s was built with ACCOUNT_TABLE_SIZE %u and ACCOUNT_INITIAL_BALANCE %lld; "
+                    "keeping those values", path, header.max_accounts, (long long)header.initial_balance);
+        config->account_table_size = (int)header.max_accounts;
+        config->account_initial_balance = header.initial_balance;
+    }
+
+    size_t journal_offset = (account_table_size(config->account_table_size) + CACHE_LINE_SIZE - 1) &
+                            ~(size_t)(CACHE_LINE_SIZE - 1);
+    int journal_capacity = 2 * config->transactions_per_block;
+    table_bytes = journal_offset + sizeof(AccountUndo) * (size_t)journal_capacity;
+    if (ftruncate(table_fd, (off_t)table_bytes) == -1) {
+        log_message("ERROR: Failed to size %s: %s", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    AccountTable* table = mmap(NULL, table_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, table_fd, 0);
+    if (table == MAP_FAILED) {
+        log_message("ERROR: mmap failed for %s: %s", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Sem shutdown limpo só se confia no page cache se a máquina não reiniciou entretanto
+    char boot_id[ACCOUNT_BOOT_ID_LEN];
+    read_boot_id(boot_id);
+    int same_boot = boot_id[0] != '\0' && strncmp(header.boot_id, boot_id, ACCOUNT_BOOT_ID_LEN) == 0;
+    int reuse = known && header.applied_height <= chain_height && (header.clean || same_boot) &&
+                header.journal_capacity == journal_capacity;
+
+    int undone = 0;
+    if (reuse) {
+        undone = recover_journal(table);
+    } else {
+        account_table_init(table, config->account_table_size, config->account_initial_balance);
+    }
+    table->journal_offset = journal_offset;
+    table->journal_capacity = journal_capacity;
+    memcpy(table->boot_id, boot_id, ACCOUNT_BOOT_ID_LEN);
+    table->clean = 0;   // Em disco antes da primeira alteração
+    if (msync(table, table_bytes, MS_SYNC) == -1) {
+        log_message("ERROR: Failed to sync %s: %s", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    table_mapped = table;
+
+    if (!reuse) {
+        LOG_INFO(LOG_CAT_LEDGER, "LEDGER: account table %s created for %d accounts%s", path, config->account_table_size,
+                 known ? " (previous table not usable after a crash or a new chain)" : "");
+    } else {
+        LOG_INFO(LOG_CAT_LEDGER, "LEDGER: account table %s reopened at height %llu (%s, %d journal entries undone)",
+                 path, (unsigned long long)atomic_load(&table->applied_height),
+                 header.clean ? "clean shutdown" : "recovered after a crash", undone);
+    }
+    return table;
+}
+
+AccountTable* account_table_attach(void) {
+    if (table_mapped == NULL) {
+        log_message("ERROR: The account table is not mapped (opened by the controller)");
+        exit(EXIT_FAILURE);
+    }
+    return table_mapped;
+}
+
+void account_table_close(AccountTable* table, int seal) {
+    if (table == NULL) {
+        return;
+    }
+    // Journal ainda por desfazer (validator morto a meio de um bloco) fica para o arranque
+    if (seal) {
+        if (msync(table, table_bytes, MS_SYNC) == 0) {
+            table->clean = 1;
+            msync(table, sizeof(AccountTable), MS_SYNC);
+        } else {
+            log_message("ERROR: Failed to sync %s: %s", ACCOUNT_TABLE_FILE, strerror(errno));
+        }
+    }
+    munmap(table, table_bytes);
+    close(table_fd);
+    table_fd = -1;
+    table_mapped = NULL;
+}
+
+// Hash de Fibonacci do id: ids consecutivos (pids, destinatários 1..N) espalham-se
+static inline uint32_t home_bucket(const AccountTable* table, int id) {
+    return (uint32_t)(((uint64_t)(uint32_t)id * 0x9e3779b97f4a7c15ull) >> 32) & table->bucket_mask;
+}
+
+// Procura a conta; se não existir devolve em *bucket/*slot o primeiro slot livre da sonda.
+// 1 se encontrou, 0 se não existe, -1 se a tabela está cheia
+static int find_slot(const AccountTable* table, int id, uint32_t* bucket, int* slot) {
+    uint32_t b = home_bucket(table, id);
+    for (uint32_t probe = 0; probe <= table->bucket_mask; probe++, b = (b + 1) & table->bucket_mask) {
+        const AccountBucket* bk = &table->buckets[b];
+        for (int s = 0; s < ACCOUNT_BUCKET_SLOTS; s++) {
+            int32_t current = atomic_load_explicit(&bk->ids[s], memory_order_acquire);
+            if (current == id) {
+                *bucket = b;
+                *slot = s;
+                return 1;
+            }
+            if (current == ACCOUNT_EMPTY) {
+                *bucket = b;
+                *slot = s;
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+int account_balance(const AccountTable* table, int id, int64_t* balance) {
+    uint32_t b;
+    int s;
+    if (id != ACCOUNT_EMPTY && find_slot(table, id, &b, &s) == 1) {
+        *balance = atomic_load_explicit(&table->buckets[b].balances[s], memory_order_relaxed);
+        return 1;
+    }
+    *balance = table->initial_balance;
+    return 0;
+}
+
+int account_batch_init(AccountBatch* batch, int n_tx) {
+    batch->count = 0;
+    batch->failed_tx = -1;
+    batch->capacity = 2 * n_tx;
+    batch->journal = NULL;
+    batch->entries = malloc(sizeof(AccountUndo) * (size_t)batch->capacity);
+    return batch->entries != NULL ? 0 : -1;
+}
+
+void account_batch_attach(AccountBatch* batch, AccountTable* table) {
+    batch->count = 0;
+    batch->failed_tx = -1;
+    batch->capacity = table->journal_capacity;
+    batch->journal = table;
+    batch->entries = journal_entries(table);
+}
+
+void account_batch_free(AccountBatch* batch) {
+    if (batch->journal == NULL) {
+        free(batch->entries);
+    }
+    batch->entries = NULL;
+    batch->count = batch->capacity = 0;
+}
+
+// Soma `delta` ao saldo de `id` (criando a conta) e regista o valor anterior para o undo
+static int adjust(AccountTable* table, int id, int64_t delta, AccountBatch* batch) {
+    uint32_t b;
+    int s;
+    int found = id != ACCOUNT_EMPTY ? find_slot(table, id, &b, &s) : -1;
+    if (found < 0 || (found == 0 && atomic_load(&table->accounts) >= table->max_accounts)) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Account table is full (%u accounts), account %d cannot be created",
+                  table->max_accounts, id);
+        return ACCOUNT_TABLE_FULL;
+    }
+
+    AccountBucket* bk = &table->buckets[b];
+    int64_t old = found ? atomic_load_explicit(&bk->balances[s], memory_order_relaxed) : table->initial_balance;
+    if (old + delta < 0) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Conta %d ficaria com saldo negativo (%lld %+lld).", id,
+                  (long long)old, (long long)delta);
+        return ACCOUNT_REJECTED;
+    }
+
+    batch->entries[batch->count++] = (AccountUndo){ .bucket = b, .slot = s, .created = !found, .old_balance = old };
+    if (batch->journal != NULL) {
+        // A entrada conta no journal antes da alteração que desfaz (morte do processo entre as duas)
+        atomic_store(&batch->journal->journal_count, batch->count);
+        atomic_signal_fence(memory_order_seq_cst);
+    }
+    atomic_store_explicit(&bk->balances[s], old + delta, memory_order_relaxed);
+    if (!found) {
+        // O saldo fica visível antes do id (leitores noutros processos)
+        atomic_store_explicit(&bk->ids[s], id, memory_order_release);
+        atomic_fetch_add_explicit(&table->accounts, 1, memory_order_relaxed);
+    }
+    return 0;
+}
+
+int account_apply_block(AccountTable* table, const TransactionBlock* block, int n_tx, AccountBatch* batch) {
+    batch->count = 0;
+    batch->failed_tx = -1;
+    if (batch->journal != NULL) {
+        atomic_store(&table->journal_count, 0);
+        atomic_store(&table->journal_height, atomic_load(&table->applied_height));
+    }
+    if (2 * n_tx > batch->capacity) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Account undo log too small for %d transactions", n_tx);
+        return -1;
+    }
+    for (int i = 0; i < n_tx; i++) {
+        const Transaction* t = &block->transactions[i];
+        if (t->value < 0) {
+            LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Transação %d tem valor negativo (%d).", t->id, t->value);
+            batch->failed_tx = i;
+            account_rollback(table, batch);
+            return ACCOUNT_REJECTED;
+        }
+        int result = adjust(table, t->sender_id, -(int64_t)t->value, batch);
+        if (result == 0) {
+            result = adjust(table, t->receiver_id, t->value, batch);
+        }
+        if (result != 0) {
+            batch->failed_tx = result == ACCOUNT_REJECTED ? i : -1;
+            account_rollback(table, batch);
+            return result;
+        }
+    }
+    return 0;
+}
+
+// Ordem inversa: as contas criadas pelo bloco são as últimas inseridas na sua sonda, por
+// isso removê-las repõe exatamente a tabela anterior (não há remoções entre blocos)
+void account_rollback(AccountTable* table, AccountBatch* batch) {
+    for (int i = batch->count - 1; i >= 0; i--) {
+        const AccountUndo* u = &batch->entries[i];
+        AccountBucket* bk = &table->buckets[u->bucket];
+        if (u->created) {
+            atomic_store_explicit(&bk->ids[u->slot], ACCOUNT_EMPTY, memory_order_release);
+            atomic_fetch_sub_explicit(&table->accounts, 1, memory_order_relaxed);
+            atomic_store_explicit(&bk->balances[u->slot], 0, memory_order_relaxed);
+        } else {
+            atomic_store_explicit(&bk->balances[u->slot], u->old_balance, memory_order_relaxed);
+        }
+        if (batch->journal != NULL) {
+            atomic_signal_fence(memory_order_seq_cst);
+            atomic_store(&batch->journal->journal_count, i);
+        }
+    }
+    batch->count = 0;
+}
+
+// applied_height avança num só store: o journal deixa de valer nesse instante
+void account_commit(AccountTable* table, AccountBatch* batch) {
+    batch->count = 0;
+    atomic_fetch_add_explicit(&table->applied_height, 1, memory_order_release);
+    if (batch->journal != NULL) {
+        atomic_store(&table->journal_count, 0);
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef ACCOUNTS_H
+#define ACCOUNTS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "common.h"
+
+#define ACCOUNT_TABLE_FILE "DEIChain_accounts.dat"
+#define ACCOUNT_TABLE_MAGIC "DEIACCT1"
+#define ACCOUNT_TABLE_VERSION 1
+#define ACCOUNT_BOOT_ID_LEN 40                     // /proc/sys/kernel/random/boot_id
+#define ACCOUNT_BUCKET_SLOTS 5                     // Contas por bucket (uma cache line)
+#define ACCOUNT_EMPTY INT32_MIN                    // id de um slot livre
+#define ACCOUNT_DEFAULT_TABLE_SIZE 65536           // Contas distintas suportadas
+#define ACCOUNT_DEFAULT_INITIAL_BALANCE 1000000000 // Saldo com que uma conta aparece pela primeira vez
+
+// Resultados de account_apply_block
+#define ACCOUNT_REJECTED -1                        // Transferência inválida (batch->failed_tx)
+#define ACCOUNT_TABLE_FULL -2                      // Sem lugar para uma conta nova; nenhuma transação tem culpa
+
+// Um bucket ocupa exatamente uma cache line: os ids juntos (a sonda compara-os todos de
+// uma vez) e os saldos a seguir
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic int32_t ids[ACCOUNT_BUCKET_SLOTS];
+    uint32_t reserved;
+    _Atomic int64_t balances[ACCOUNT_BUCKET_SLOTS];
+} AccountBucket;
+
+_Static_assert(sizeof(AccountBucket) == CACHE_LINE_SIZE, "AccountBucket must fill one cache line");
+
+// Undo entry of the block being applied
+typedef struct {
+    uint32_t bucket;
+    int slot;
+    int created;             // A conta foi criada por este bloco
+    int64_t old_balance;
+} AccountUndo;
+
+// Account balances keyed by account id, in a memory-mapped file next to the ledger
+// (ACCOUNT_TABLE_FILE) that every process inherits from the controller. Open addressing over
+// cache-line buckets with linear probing between buckets; accounts are never removed, so
+// a lookup stops at the first bucket with a free slot. The table is sized for at most
+// half-full buckets, so a balance query touches one cache line on average, whatever the
+// length of the chain.
+//
+// Only the validator writes. It applies each block in place and records an undo entry
+// per touched account; a rejected block is undone in reverse order (including the
+// accounts it created), so a rollback costs O(transactions in the block). Readers in
+// other processes may briefly see the balances of a block that is then rolled back.
+//
+// The table covers the first applied_height blocks of the chain, so a restart only
+// replays the blocks after that. The validator keeps the undo entries of the block being
+// applied in the file too (the journal), each one written before the change it undoes:
+// after a crash of the process, the page cache holds the table exactly as it was, and
+// undoing the journal returns it to applied_height. The size and initial balance in the
+// file win over the configuration, since they are part of the rules the chain was
+// validated with. Only when the file was not closed cleanly and the machine has rebooted
+// since (dirty pages may be lost) is the table rebuilt from the whole chain.
+typedef struct {
+    char magic[8];                   // ACCOUNT_TABLE_MAGIC
+    uint32_t version;
+    uint32_t clean;                  // 1 depois de um shutdown limpo (tudo em disco)
+    char boot_id[ACCOUNT_BOOT_ID_LEN];   // Arranque da máquina em que foi aberta pela última vez
+    uint32_t bucket_mask;            // Número de buckets - 1 (potência de 2)
+    uint32_t max_accounts;           // ACCOUNT_TABLE_SIZE: acima disto os blocos são rejeitados
+    int64_t initial_balance;
+    _Atomic uint64_t accounts;       // Contas conhecidas
+    _Atomic uint64_t applied_height; // Blocos da cadeia já aplicados
+    size_t journal_offset;           // AccountUndo[journal_capacity], depois dos buckets
+    int journal_capacity;
+    _Atomic int journal_count;       // Entradas do journal ainda por desfazer
+    _Atomic uint64_t journal_height; // Bloco a que o journal pertence (só vale se == applied_height)
+    _Alignas(CACHE_LINE_SIZE) AccountBucket buckets[];
+} AccountTable;
+
+// Undo log of the block being applied: in the table file for the validator
+// (account_batch_attach), in memory elsewhere (account_batch_init)
+typedef struct {
+    AccountUndo* entries;
+    int count;
+    int capacity;            // 2 por transação: remetente e destinatário
+    int failed_tx;           // Transação que fez falhar o último account_apply_block, ou -1
+    AccountTable* journal;   // Tabela cujo journal são as entries, ou NULL
+} AccountBatch;
+
+size_t account_table_size(int accounts);            // Cabeçalho e buckets (sem o journal)
+void account_table_init(AccountTable* table, int accounts, int64_t initial_balance);
+
+// Controller: abre ou cria ACCOUNT_TABLE_FILE. Pode corrigir account_table_size e
+// account_initial_balance em `config` para os valores do ficheiro. Quem chama aplica os
+// blocos a partir de applied_height até chain_height.
+AccountTable* account_table_open(const char* path, Config* config, uint64_t chain_height);
+AccountTable* account_table_attach(void);           // Processos filhos: o mapeamento herdado
+void account_table_close(AccountTable* table, int seal);   // seal: controller, tudo em disco e clean
+
+// O(1): 1 se a conta existe; uma conta desconhecida tem o saldo inicial (devolve 0)
+int account_balance(const AccountTable* table, int id, int64_t* balance);
+
+int account_batch_init(AccountBatch* batch, int n_tx);
+void account_batch_attach(AccountBatch* batch, AccountTable* table);   // Journal no ficheiro
+void account_batch_free(AccountBatch* batch);
+
+// Aplica as transferências do bloco por ordem; qualquer falha desfaz o que já foi aplicado.
+// Um saldo negativo (descoberto ou gasto duplo) ou um valor negativo: ACCOUNT_REJECTED,
+// com a posição da transação culpada em batch->failed_tx. Tabela cheia: ACCOUNT_TABLE_FULL,
+// com failed_tx a -1 (as transações são válidas)
+int account_apply_block(AccountTable* table, const TransactionBlock* block, int n_tx, AccountBatch* batch);
+void account_rollback(AccountTable* table, AccountBatch* batch);   // Bloco rejeitado
+void account_commit(AccountTable* table, AccountBatch* batch);     // Bloco na cadeia
+
+#endif
@@ -0,0 +1,283 @@
+#include "archive.h"
+#include "ledger.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+static int data_fd = -1;
+static int index_fd = -1;
+static uint64_t data_end = 0;           // Fim do último segmento confirmado
+static pthread_mutex_t archive_lock = PTHREAD_MUTEX_INITIALIZER;   // Thread de arquivo vs. arquivo inline e leituras
+
+// Buffers de um segmento (bloco em claro e comprimido), reservados no primeiro uso
+static unsigned char* raw_buf = NULL;
+static unsigned char* packed_buf = NULL;
+static size_t packed_cap = 0;
+
+// Segmento descomprimido mais recente, para leituras seguidas no mesmo segmento
+static unsigned char* read_buf = NULL;
+static uint64_t read_segment = UINT64_MAX;
+
+static pthread_t archiver_thread;
+static int archiver_running = 0;
+static int archiver_wakeup = 0;
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+
+static uint32_t entry_checksum(const ArchiveIndexEntry* entry) {
+    return ~ledger_crc32c(~0u, entry, offsetof(ArchiveIndexEntry, entry_checksum));
+}
+
+static size_t segment_raw_size(const Blockchain* chain) {
+    return (size_t)chain->segment_blocks * chain->block_size;
+}
+
+static int read_entry(int fd, uint64_t segment, ArchiveIndexEntry* entry) {
+    off_t at = (off_t)(segment * sizeof(ArchiveIndexEntry));
+    return pread(fd, entry, sizeof(*entry), at) == (ssize_t)sizeof(*entry) &&
+           entry->entry_checksum == entry_checksum(entry) ? 0 : -1;
+}
+
+static int open_archive_file(const char* path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to open %s: %s", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+void archive_open(Blockchain* chain) {
+    data_fd = open_archive_file(ARCHIVE_DATA_FILE);
+    index_fd = open_archive_file(ARCHIVE_INDEX_FILE);
+
+    uint64_t segments = atomic_load(&chain->archived_count) / (uint64_t)chain->segment_blocks;
+    struct stat st;
+    if (fstat(index_fd, &st) == -1 || (uint64_t)st.st_size < segments * sizeof(ArchiveIndexEntry)) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: %s is missing segments recorded in %s", ARCHIVE_INDEX_FILE, LEDGER_FILE);
+        exit(EXIT_FAILURE);
+    }
+
+    data_end = 0;
+    if (segments > 0) {
+        ArchiveIndexEntry last;
+        if (read_entry(index_fd, segments - 1, &last) == -1 ||
+            last.first_height != (segments - 1) * (uint64_t)chain->segment_blocks) {
+            LOG_ERROR(LOG_CAT_LEDGER, "ERROR: %s is corrupt (segment %llu)", ARCHIVE_INDEX_FILE,
+                      (unsigned long long)segments - 1);
+            exit(EXIT_FAILURE);
+        }
+        data_end = last.offset + last.compressed_size;
+    }
+
+    // Um segmento escrito mas não confirmado no cabeçalho do ledger é descartado
+    off_t index_end = (off_t)(segments * sizeof(ArchiveIndexEntry));
+    off_t cut = (off_t)st.st_size - index_end;
+    if (ftruncate(index_fd, index_end) == -1 || ftruncate(data_fd, (off_t)data_end) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to truncate the archive: %s", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (cut > 0) {
+        LOG_INFO(LOG_CAT_LEDGER, "LEDGER: %lld unconfirmed archive index bytes dropped", (long long)cut);
+    }
+    LOG_INFO(LOG_CAT_LEDGER, "LEDGER: archive has %llu segments of %d blocks (%llu bytes)",
+             (unsigned long long)segments, chain->segment_blocks, (unsigned long long)data_end);
+}
+
+int archive_segment(Blockchain* chain) {
+    pthread_mutex_lock(&archive_lock);
+
+    uint64_t first = atomic_load(&chain->archived_count);
+    uint64_t n = (uint64_t)chain->segment_blocks;
+    // Só blocos já sincronizados: o arquivo nunca vai à frente do ledger
+    if (atomic_load(&chain->synced_count) < first + n) {
+        pthread_mutex_unlock(&archive_lock);
+        return 0;
+    }
+
+    size_t raw_size = segment_raw_size(chain);
+    if (raw_buf == NULL) {
+        packed_cap = compressBound(raw_size);
+        raw_buf = malloc(raw_size);
+        packed_buf = malloc(packed_cap);
+        if (raw_buf == NULL || packed_buf == NULL) {
+            LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Cannot allocate the archive buffers");
+            pthread_mutex_unlock(&archive_lock);
+            return -1;
+        }
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        memcpy(raw_buf + i * chain->block_size, blockchain_block_at(chain, first + i), chain->block_size);
+    }
+
+    uLongf packed_size = packed_cap;
+    if (compress2(packed_buf, &packed_size, raw_buf, raw_size, Z_BEST_SPEED) != Z_OK) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: zlib failed on the segment at height %llu", (unsigned long long)first);
+        pthread_mutex_unlock(&archive_lock);
+        return -1;
+    }
+
+    ArchiveIndexEntry entry = {
+        .first_height = first, .offset = data_end, .compressed_size = (uint32_t)packed_size,
+        .block_count = (uint32_t)n, .checksum = ~ledger_crc32c(~0u, packed_buf, packed_size),
+    };
+    entry.entry_checksum = entry_checksum(&entry);
+
+    // Dados e índice em disco antes de archived_count avançar e o slot poder ser reutilizado
+    uint64_t segment = first / n;
+    if (pwrite(data_fd, packed_buf, packed_size, (off_t)data_end) != (ssize_t)packed_size ||
+        fdatasync(data_fd) == -1 ||
+        pwrite(index_fd, &entry, sizeof(entry), (off_t)(segment * sizeof(entry))) != (ssize_t)sizeof(entry) ||
+        fdatasync(index_fd) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to write archive segment %llu: %s", (unsigned long long)segment,
+                  strerror(errno));
+        pthread_mutex_unlock(&archive_lock);
+        return -1;
+    }
+    data_end += packed_size;
+    atomic_store(&chain->archived_count, first + n);
+    msync(chain, sizeof(Blockchain), MS_SYNC);
+
+    pthread_mutex_unlock(&archive_lock);
+    LOG_DEBUG(LOG_CAT_LEDGER, "LEDGER: heights %llu-%llu archived (%zu -> %lu bytes)", (unsigned long long)first,
+              (unsigned long long)(first + n - 1), raw_size, (unsigned long)packed_size);
+    return 1;
+}
+
+// Acorda quando ledger_sync confirma registos, ou de segundo a segundo
+static void* archiver_main(void* arg) {
+    Blockchain* chain = arg;
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);   // Os sinais ficam para a thread principal do validator
+
+    pthread_mutex_lock(&wake_lock);
+    while (archiver_running) {
+        pthread_mutex_unlock(&wake_lock);
+        int archived = archive_segment(chain);
+        pthread_mutex_lock(&wake_lock);
+
+        if (archived != 1 && archiver_running && !archiver_wakeup) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            pthread_cond_timedwait(&wake_cond, &wake_lock, &deadline);
+        }
+        archiver_wakeup = 0;
+    }
+    pthread_mutex_unlock(&wake_lock);
+    return NULL;
+}
+
+void archive_start(Blockchain* chain) {
+    archiver_running = 1;
+    if (pthread_create(&archiver_thread, NULL, archiver_main, chain) != 0) {
+        archiver_running = 0;
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to start the archiver; blocks will be archived inline");
+    }
+}
+
+void archive_stop(void) {
+    pthread_mutex_lock(&wake_lock);
+    int running = archiver_running;
+    archiver_running = 0;
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_lock);
+    if (running) {
+        pthread_join(archiver_thread, NULL);
+    }
+}
+
+void archive_notify(void) {
+    pthread_mutex_lock(&wake_lock);
+    archiver_wakeup = 1;
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_lock);
+}
+
+// Chamado com archive_lock: read_buf/read_segment são partilhados por todas as threads
+static int read_block_locked(const Blockchain* chain, uint64_t height, TransactionBlock* out) {
+    // Leitores fora do controller (ferramentas) abrem o arquivo só para leitura.
+    // Os dois descritores só ficam guardados se ambos abrirem
+    if (index_fd == -1) {
+        int index = open(ARCHIVE_INDEX_FILE, O_RDONLY);
+        int data = open(ARCHIVE_DATA_FILE, O_RDONLY);
+        if (index == -1 || data == -1) {
+            if (index != -1) {
+                close(index);
+            }
+            if (data != -1) {
+                close(data);
+            }
+            return -1;
+        }
+        index_fd = index;
+        data_fd = data;
+    }
+
+    size_t raw_size = segment_raw_size(chain);
+    uint64_t segment = height / (uint64_t)chain->segment_blocks;
+    if (segment != read_segment) {
+        ArchiveIndexEntry entry;
+        unsigned char* packed = NULL;
+        if (read_buf == NULL && (read_buf = malloc(raw_size)) == NULL) {
+            return -1;
+        }
+        read_segment = UINT64_MAX;
+        if (read_entry(index_fd, segment, &entry) == -1 || (packed = malloc(entry.compressed_size)) == NULL) {
+            return -1;
+        }
+
+        uLongf unpacked = raw_size;
+        int ok = pread(data_fd, packed, entry.compressed_size, (off_t)entry.offset) == (ssize_t)entry.compressed_size &&
+                 entry.checksum == ~ledger_crc32c(~0u, packed, entry.compressed_size) &&
+                 uncompress(read_buf, &unpacked, packed, entry.compressed_size) == Z_OK && unpacked == raw_size;
+        free(packed);
+        if (!ok) {
+            return -1;
+        }
+        read_segment = segment;
+    }
+
+    size_t at = (size_t)(height % (uint64_t)chain->segment_blocks) * chain->block_size;
+    memcpy(out, read_buf + at, chain->block_size);
+    return 0;
+}
+
+int archive_read_block(const Blockchain* chain, uint64_t height, TransactionBlock* out) {
+    if (height >= atomic_load(&chain->archived_count)) {
+        return -1;
+    }
+    pthread_mutex_lock(&archive_lock);
+    int rc = read_block_locked(chain, height, out);
+    pthread_mutex_unlock(&archive_lock);
+    return rc;
+}
+
+void archive_close(void) {
+    archive_stop();
+    if (data_fd != -1) {
+        close(data_fd);
+        data_fd = -1;
+    }
+    if (index_fd != -1) {
+        close(index_fd);
+        index_fd = -1;
+    }
+    free(raw_buf);
+    free(packed_buf);
+    free(read_buf);
+    raw_buf = packed_buf = read_buf = NULL;
+    read_segment = UINT64_MAX;
+}
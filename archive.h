@@ -0,0 +1,38 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include "common.h"
+
+#define ARCHIVE_DATA_FILE "DEIChain_archive.dat"
+#define ARCHIVE_INDEX_FILE "DEIChain_archive.idx"
+#define ARCHIVE_SEGMENT_BLOCKS 128     // Blocos por segmento (no máximo metade da janela)
+
+// Uma entrada por segmento, no índice: a altura h está na entrada h / segment_blocks
+typedef struct {
+    uint64_t first_height;
+    uint64_t offset;            // Início do segmento comprimido em ARCHIVE_DATA_FILE
+    uint32_t compressed_size;
+    uint32_t block_count;
+    uint32_t checksum;          // CRC32C dos dados comprimidos
+    uint32_t entry_checksum;    // CRC32C dos campos anteriores
+} ArchiveIndexEntry;
+
+// Cold storage for blocks that leave the in-memory window. Each segment is
+// segment_blocks consecutive blocks compressed with zlib and appended to the data file;
+// the index maps height -> segment -> file offset in O(1). A segment only counts once
+// both files are synced and the ledger header's archived_count has moved past it, so
+// anything beyond archived_count after a crash is cut off by archive_open.
+//
+// The validator runs the archiver in a background thread. The ring slot of a block is
+// only reused once that block is archived; if the archiver falls a whole window behind,
+// ledger_append archives inline.
+void archive_open(Blockchain* chain);          // Controller: abre ou cria e corta o que não foi confirmado
+int archive_segment(Blockchain* chain);        // 1 se arquivou um segmento, 0 se não há nenhum completo, -1 erro
+void archive_start(Blockchain* chain);         // Validator: thread de arquivo
+void archive_stop(void);
+void archive_notify(void);                     // Há registos novos sincronizados
+int archive_read_block(const Blockchain* chain, uint64_t height, TransactionBlock* out);   // 0 ou -1, thread-safe
+void archive_close(void);
+
+#endif
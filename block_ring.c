@@ -0,0 +1,145 @@
+#include "block_ring.h"
+#include "futex.h"
+#include "logging.h"
+#include "trace.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define RING_WAIT_MS 200   // Espera máxima antes de voltar a verificar o flag de execução
+
+static size_t block_ring_slot_size(void) {
+    return CACHE_LINE_SIZE + get_transaction_block_size();
+}
+
+size_t block_ring_size(int capacity) {
+    return sizeof(BlockRing) + (size_t)capacity * block_ring_slot_size();
+}
+
+void block_ring_init(BlockRing* ring, int capacity) {
+    ring->capacity = capacity;
+    ring->slot_size = block_ring_slot_size();
+    atomic_store(&ring->next_publish_seq, 0);
+    atomic_store(&ring->published, 0);
+    atomic_store(&ring->consumer_waiting, 0);
+    atomic_store(&ring->freed, 0);
+    atomic_store(&ring->producers_waiting, 0);
+
+    for (int i = 0; i < capacity; i++) {
+        BlockRingSlot* slot = block_ring_slot_at(ring, i);
+        atomic_store(&slot->state, RING_SLOT_FREE);
+        slot->miner_id = -1;
+        slot->publish_seq = 0;
+    }
+}
+
+// Abre o ring criado pelo controller (sem o criar)
+BlockRing* open_block_ring_memory(void) {
+    size_t size = block_ring_size(BLOCK_RING_SLOTS);
+
+    int fd = shm_open(BLOCK_RING_SHM, O_RDWR, 0666);
+    if (fd == -1) {
+        log_message("ERROR: shm_open failed for %s", BLOCK_RING_SHM);
+        exit(EXIT_FAILURE);
+    }
+
+    BlockRing* ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        log_message("ERROR: mmap failed for %s", BLOCK_RING_SHM);
+        exit(EXIT_FAILURE);
+    }
+
+    LOG_INFO(LOG_CAT_SHM, "SHM: block ring opened and mapped (%d slots)", ring->capacity);
+    return ring;
+}
+
+void close_block_ring_memory(BlockRing* ring) {
+    if (ring != NULL) {
+        munmap(ring, block_ring_size(BLOCK_RING_SLOTS));
+    }
+}
+
+BlockRingSlot* block_ring_acquire(BlockRing* ring, int miner_id, const volatile sig_atomic_t* running) {
+    int start = miner_id > 0 ? miner_id % ring->capacity : 0;
+
+    while (*running) {
+        uint32_t seen = atomic_load(&ring->freed);
+
+        for (int k = 0; k < ring->capacity; k++) {
+            BlockRingSlot* slot = block_ring_slot_at(ring, (start + k) % ring->capacity);
+            uint32_t expected = RING_SLOT_FREE;
+            if (atomic_load_explicit(&slot->state, memory_order_relaxed) == RING_SLOT_FREE &&
+                atomic_compare_exchange_strong(&slot->state, &expected, RING_SLOT_FILLING)) {
+                slot->miner_id = miner_id;
+                return slot;
+            }
+        }
+
+        // Ring cheio: dorme até o validator libertar um slot
+        atomic_fetch_add(&ring->producers_waiting, 1);
+        futex_wait(&ring->freed, seen, RING_WAIT_MS);
+        atomic_fetch_sub(&ring->producers_waiting, 1);
+    }
+    return NULL;
+}
+
+void block_ring_publish(BlockRing* ring, BlockRingSlot* slot) {
+    slot->publish_seq = atomic_fetch_add(&ring->next_publish_seq, 1);
+    slot->publish_ns = trace_now_ns();
+    atomic_store_explicit(&slot->state, RING_SLOT_READY, memory_order_release);
+
+    atomic_fetch_add(&ring->published, 1);
+    if (atomic_load(&ring->consumer_waiting)) {
+        futex_wake(&ring->published, 1);
+    }
+}
+
+// Devolve um slot que não chegou a ser publicado (ex.: miner interrompido)
+void block_ring_abandon(BlockRing* ring, BlockRingSlot* slot) {
+    block_ring_release(ring, slot);
+}
+
+static BlockRingSlot* block_ring_oldest_ready(BlockRing* ring) {
+    BlockRingSlot* oldest = NULL;
+
+    for (int i = 0; i < ring->capacity; i++) {
+        BlockRingSlot* slot = block_ring_slot_at(ring, i);
+        if (atomic_load_explicit(&slot->state, memory_order_acquire) == RING_SLOT_READY &&
+            (oldest == NULL || slot->publish_seq < oldest->publish_seq)) {
+            oldest = slot;
+        }
+    }
+    return oldest;
+}
+
+BlockRingSlot* block_ring_consume(BlockRing* ring, int timeout_ms) {
+    BlockRingSlot* slot = block_ring_oldest_ready(ring);
+
+    if (slot == NULL && timeout_ms != 0) {
+        uint32_t seen = atomic_load(&ring->published);
+        atomic_store(&ring->consumer_waiting, 1);
+        // Volta a verificar depois de anunciar a espera para não perder uma publicação
+        slot = block_ring_oldest_ready(ring);
+        if (slot == NULL) {
+            futex_wait(&ring->published, seen, timeout_ms);
+            slot = block_ring_oldest_ready(ring);
+        }
+        atomic_store(&ring->consumer_waiting, 0);
+    }
+
+    if (slot != NULL) {
+        atomic_store_explicit(&slot->state, RING_SLOT_CONSUMING, memory_order_relaxed);
+    }
+    return slot;
+}
+
+void block_ring_release(BlockRing* ring, BlockRingSlot* slot) {
+    slot->miner_id = -1;
+    atomic_store_explicit(&slot->state, RING_SLOT_FREE, memory_order_release);
+
+    atomic_fetch_add(&ring->freed, 1);
+    if (atomic_load(&ring->producers_waiting)) {
+        futex_wake_all(&ring->freed);
+    }
+}
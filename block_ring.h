@@ -0,0 +1,64 @@
+#ifndef BLOCK_RING_H
+#define BLOCK_RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include "common.h"
+
+#define BLOCK_RING_SHM "/block_ring_shm"
+#define BLOCK_RING_SLOTS 32
+
+// Estados de um slot do ring
+enum {
+    RING_SLOT_FREE = 0,
+    RING_SLOT_FILLING,     // Um miner está a montar/minerar o bloco no slot
+    RING_SLOT_READY,       // Publicado, à espera do validator
+    RING_SLOT_CONSUMING,   // Em validação
+};
+
+// Cabeçalho de um slot; o bloco segue-se no próximo múltiplo da cache line
+typedef struct {
+    _Atomic uint32_t state;
+    int miner_id;
+    uint64_t publish_seq;   // Ordem de publicação (o validator consome pela ordem)
+    uint64_t publish_ns;    // CLOCK_MONOTONIC da publicação (latência de validação)
+} BlockRingSlot;
+
+// Multi-producer/single-consumer ring of block slots in shared memory. Miners build
+// candidate blocks in place and publish them; the validator consumes them in place.
+// Slots are claimed individually, so a slow miner never blocks the others' slots.
+typedef struct {
+    int capacity;
+    size_t slot_size;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t next_publish_seq;
+    _Atomic uint32_t published;            // Futex: incrementado a cada publicação
+    _Atomic uint32_t consumer_waiting;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t freed;   // Futex: incrementado a cada slot libertado
+    _Atomic uint32_t producers_waiting;
+    _Alignas(CACHE_LINE_SIZE) unsigned char slots[];
+} BlockRing;
+
+size_t block_ring_size(int capacity);
+void block_ring_init(BlockRing* ring, int capacity);
+BlockRing* open_block_ring_memory(void);
+void close_block_ring_memory(BlockRing* ring);
+
+static inline BlockRingSlot* block_ring_slot_at(BlockRing* ring, int index) {
+    return (BlockRingSlot*)(ring->slots + (size_t)index * ring->slot_size);
+}
+
+static inline TransactionBlock* block_ring_slot_block(BlockRingSlot* slot) {
+    return (TransactionBlock*)((unsigned char*)slot + CACHE_LINE_SIZE);
+}
+
+// Producer side
+BlockRingSlot* block_ring_acquire(BlockRing* ring, int miner_id, const volatile sig_atomic_t* running);
+void block_ring_publish(BlockRing* ring, BlockRingSlot* slot);
+void block_ring_abandon(BlockRing* ring, BlockRingSlot* slot);
+
+// Consumer side: oldest published slot, or NULL after timeout_ms without one
+BlockRingSlot* block_ring_consume(BlockRing* ring, int timeout_ms);
+void block_ring_release(BlockRing* ring, BlockRingSlot* slot);
+
+#endif
@@ -1,97 +1,197 @@
-#include "common.h"     // Para as definições do seu projeto
-#include "logging.h"    // Para a função log_message()
-#include <sys/mman.h>   // Para shm_open, mmap
-#include <fcntl.h>      // Para open, O_RDWR, etc.
-#include <unistd.h>     // Para read, write, close
-#include <errno.h>      // Para manipulação de erros
-#include <stdlib.h>     // Para funções de alocação de memória e exit
-#include <string.h>     // Para manipulação de strings
-#include <stdio.h> 
-
-int tx_pool_fd = -1;           // Actual definition
-TransactionPool* tx_pool_ptr = NULL;      
-
-void load_config(const char *filename, Config *config) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        log_message("ERROR: Failed to open configuration file %s", filename);
-        exit(EXIT_FAILURE);
-    }
-
-    if (fscanf(file, "%d", &config->num_miners) != 1 ||
-        fscanf(file, "%d", &config->pool_size) != 1 ||
-        fscanf(file, "%d", &config->transactions_per_block) != 1 ||
-        fscanf(file, "%d", &config->blockchain_blocks) != 1) {
-        
-        log_message("ERROR: Incorrect format in configuration file");
-        fclose(file);
-        exit(EXIT_FAILURE);
-    }
-    fclose(file);
-    
-    if (config->num_miners <= 0 || config->pool_size <= 0 || 
-        config->transactions_per_block <= 0 || config->blockchain_blocks <= 0) {
-        log_message("ERROR: Invalid configuration values (must be positive)");
-        exit(EXIT_FAILURE);
-    }
-
-    log_message("CONFIG: NUM_MINERS = %d", config->num_miners);
-    log_message("CONFIG: POOL_SIZE = %d", config->pool_size);
-    log_message("CONFIG: TRANSACTIONS_PER_BLOCK = %d", config->transactions_per_block);
-    log_message("CONFIG: BLOCKCHAIN_BLOCKS = %d", config->blockchain_blocks);
-} 
-
-int open_fifo(const char* fifo_path, int mode) {
-    int fifo_fd = open(fifo_path, mode);
-    if (fifo_fd == -1) {
-        log_message("ERROR: Failed to open FIFO %s with mode %d: %s", fifo_path, mode, strerror(errno));
-        return -1;
-    }
-    log_message("INFO: FIFO %s opened successfully with mode %d", fifo_path, mode);
-    return fifo_fd;
-}
-
-void close_fifo(int fifo_fd, const char* fifo_path) {
-    if (fifo_fd != -1) {
-        if (close(fifo_fd) == 0) {
-            log_message("INFO: FIFO %s closed successfully", fifo_path);
-        } else {
-            log_message("ERROR: Failed to close FIFO %s: %s", fifo_path, strerror(errno));
-        }
-    } else {
-        log_message("ERROR: FIFO %s was not opened or invalid FD", fifo_path);
-    }
-}
-
-// Função para abrir a memória compartilhada da tx_pool (sem criá-la)
-void open_tx_pool_memory() {
-    // Get the size from the config (no fstat needed)
-    size_t total_size = sizeof(TransactionPool) + 
-                        sizeof(Transaction) * global_config.pool_size;
-
-    // Open existing shared memory (no creation)
-    tx_pool_fd = shm_open(TX_POOL_SHM, O_RDWR, 0666);
-    if (tx_pool_fd == -1) {
-        log_message("ERROR: shm_open failed for %s", TX_POOL_SHM);
-        exit(EXIT_FAILURE);
-    }
-
-    // Map the memory using the precomputed size
-    tx_pool_ptr = mmap(NULL, total_size, PROT_READ | PROT_WRITE, 
-                       MAP_SHARED, tx_pool_fd, 0);
-    if (tx_pool_ptr == MAP_FAILED) {
-        log_message("ERROR: mmap failed for %s", TX_POOL_SHM);
-        exit(EXIT_FAILURE);
-    }
-
-    log_message("SHM: tx_pool opened and mapped (size based on config)");
-}
-
-static inline size_t get_transaction_block_size() {
-  if (transactions_per_block == 0) {
-    perror("Must set the 'transactions_per_block' variable before using!\n");
-    exit(-1);
-  }
-  return sizeof(TransactionBlock) +
-         transactions_per_block * sizeof(Transaction);
-}
\ No newline at end of file
+#include "common.h"     // Para as definições do seu projeto
+#include "logging.h"    // Para a função log_message()
+#include <sys/mman.h>   // Para shm_open, mmap
+#include <fcntl.h>      // Para open, O_RDWR, etc.
+#include <unistd.h>     // Para read, write, close
+#include <errno.h>      // Para manipulação de erros
+#include <stdlib.h>     // Para funções de alocação de memória e exit
+#include <string.h>     // Para manipulação de strings
+#include <stdio.h> 
+#include <limits.h>     // INT_MIN, INT_MAX
+#include "pow.h"      // POW_DEFAULT_DIFFICULTY
+#include "tx_pool.h"
+#include "stats.h"      // STATS_DEFAULT_INTERVAL
+#include "ledger.h"     // LEDGER_DEFAULT_GROUP_COMMIT
+#include "accounts.h"   // ACCOUNT_DEFAULT_*
+#include "validator.h"  // VALIDATOR_MAX_THREADS
+
+Config global_config;
+size_t transactions_per_block = 0;
+int tx_pool_fd = -1;           // Actual definition
+TransactionPool* tx_pool_ptr = NULL;      
+Blockchain* blockchain_ptr = NULL;
+
+// Parses the optional "KEY VALUE" lines that follow the four mandatory values
+static void load_optional_settings(FILE* file, Config *config) {
+    char key[64];
+    long long wide;
+    int value;
+
+    while (fscanf(file, "%63s %lld", key, &wide) == 2) {
+        // O saldo inicial é int64_t; as restantes chaves são int
+        if (strcmp(key, "ACCOUNT_INITIAL_BALANCE") == 0) {
+            config->account_initial_balance = wide;
+            continue;
+        }
+        if (wide < INT_MIN || wide > INT_MAX) {
+            log_message("ERROR: %s value %lld out of range", key, wide);
+            exit(EXIT_FAILURE);
+        }
+        value = (int)wide;
+
+        if (strcmp(key, "POW_DIFFICULTY") == 0) {
+            config->pow_difficulty = value;
+        } else if (strcmp(key, "MINER_TEAM_SIZE") == 0) {
+            config->miner_team_size = value;
+        } else if (strcmp(key, "TX_LEASE_SECONDS") == 0) {
+            config->tx_lease_seconds = value;
+        } else if (strcmp(key, "LOG_ASYNC") == 0) {
+            config->log_async = value != 0;
+        } else if (strcmp(key, "STATS_INTERVAL") == 0) {
+            config->stats_interval = value;
+        } else if (strcmp(key, "TX_POOL_SHARDS") == 0) {
+            config->tx_pool_shards = value;
+        } else if (strcmp(key, "LEDGER_GROUP_COMMIT") == 0) {
+            config->ledger_group_commit = value;
+        } else if (strcmp(key, "ACCOUNT_TABLE_SIZE") == 0) {
+            config->account_table_size = value;
+        } else if (strcmp(key, "VALIDATOR_THREADS") == 0) {
+            config->validator_threads = value;
+        } else if (strcmp(key, "TRACE") == 0) {
+            config->trace = value != 0;
+        } else if (strcmp(key, "LOG_LEVEL") == 0) {
+            log_set_level(-1, value);
+            log_message("CONFIG: LOG_LEVEL = %d", value);
+        } else if (strncmp(key, "LOG_LEVEL_", 10) == 0 && log_category_from_name(key + 10) >= 0) {
+            log_set_level(log_category_from_name(key + 10), value);
+            log_message("CONFIG: %s = %d", key, value);
+        } else {
+            log_message("WARNING: Unknown configuration key %s ignored", key);
+        }
+    }
+}
+
+void load_config(const char *filename, Config *config) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        log_message("ERROR: Failed to open configuration file %s", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    if (fscanf(file, "%d", &config->num_miners) != 1 ||
+        fscanf(file, "%d", &config->pool_size) != 1 ||
+        fscanf(file, "%d", &config->transactions_per_block) != 1 ||
+        fscanf(file, "%d", &config->blockchain_blocks) != 1) {
+        
+        log_message("ERROR: Incorrect format in configuration file");
+        fclose(file);
+        exit(EXIT_FAILURE);
+    }
+
+    config->pow_difficulty = POW_DEFAULT_DIFFICULTY;
+    config->miner_team_size = 0;
+    config->tx_lease_seconds = TX_DEFAULT_LEASE_SECONDS;
+    config->log_async = 1;
+    config->trace = 0;
+    config->stats_interval = STATS_DEFAULT_INTERVAL;
+    config->tx_pool_shards = 0;
+    config->ledger_group_commit = LEDGER_DEFAULT_GROUP_COMMIT;
+    config->account_table_size = ACCOUNT_DEFAULT_TABLE_SIZE;
+    config->account_initial_balance = ACCOUNT_DEFAULT_INITIAL_BALANCE;
+    config->validator_threads = 0;
+    load_optional_settings(file, config);
+    fclose(file);
+    
+    if (config->num_miners <= 0 || config->pool_size <= 0 || 
+        config->transactions_per_block <= 0 || config->blockchain_blocks <= 0) {
+        log_message("ERROR: Invalid configuration values (must be positive)");
+        exit(EXIT_FAILURE);
+    }
+
+    if (config->pow_difficulty < 0 || config->pow_difficulty > POW_MAX_DIFFICULTY) {
+        log_message("ERROR: POW_DIFFICULTY must be between 0 and %d", POW_MAX_DIFFICULTY);
+        exit(EXIT_FAILURE);
+    }
+    // Por omissão todas as threads cooperam no mesmo bloco candidato
+    if (config->miner_team_size <= 0 || config->miner_team_size > config->num_miners) {
+        config->miner_team_size = config->num_miners;
+    }
+    if (config->miner_team_size > POW_MAX_WORKERS) {
+        config->miner_team_size = POW_MAX_WORKERS;
+    }
+    if (config->stats_interval <= 0) {
+        log_message("ERROR: STATS_INTERVAL must be positive");
+        exit(EXIT_FAILURE);
+    }
+    if (config->tx_lease_seconds <= 0) {
+        log_message("ERROR: TX_LEASE_SECONDS must be positive");
+        exit(EXIT_FAILURE);
+    }
+    if (config->ledger_group_commit <= 0) {
+        log_message("ERROR: LEDGER_GROUP_COMMIT must be positive");
+        exit(EXIT_FAILURE);
+    }
+    if (config->account_table_size <= 0) {
+        log_message("ERROR: ACCOUNT_TABLE_SIZE must be positive");
+        exit(EXIT_FAILURE);
+    }
+    if (config->account_initial_balance < 0) {
+        log_message("ERROR: ACCOUNT_INITIAL_BALANCE cannot be negative");
+        exit(EXIT_FAILURE);
+    }
+    if (config->validator_threads < 0 || config->validator_threads > VALIDATOR_MAX_THREADS) {
+        log_message("ERROR: VALIDATOR_THREADS must be between 0 and %d", VALIDATOR_MAX_THREADS);
+        exit(EXIT_FAILURE);
+    }
+    // Por omissão um worker de verificação por CPU
+    if (config->validator_threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config->validator_threads = cpus < 1 ? 1 : cpus > VALIDATOR_MAX_THREADS ? VALIDATOR_MAX_THREADS : (int)cpus;
+    }
+    if (config->tx_pool_shards < 0 || config->tx_pool_shards > TX_POOL_MAX_SHARDS) {
+        log_message("ERROR: TX_POOL_SHARDS must be between 0 and %d", TX_POOL_MAX_SHARDS);
+        exit(EXIT_FAILURE);
+    }
+    // Todos os processos resolvem o mesmo valor: o layout da pool depende dele
+    config->tx_pool_shards = tx_pool_shard_count(config->pool_size, config->tx_pool_shards);
+    transactions_per_block = config->transactions_per_block;
+
+    log_message("CONFIG: NUM_MINERS = %d", config->num_miners);
+    log_message("CONFIG: POOL_SIZE = %d", config->pool_size);
+    log_message("CONFIG: TRANSACTIONS_PER_BLOCK = %d", config->transactions_per_block);
+    log_message("CONFIG: BLOCKCHAIN_BLOCKS = %d", config->blockchain_blocks);
+    log_message("CONFIG: POW_DIFFICULTY = %d", config->pow_difficulty);
+    log_message("CONFIG: MINER_TEAM_SIZE = %d", config->miner_team_size);
+    log_message("CONFIG: TX_LEASE_SECONDS = %d", config->tx_lease_seconds);
+    log_message("CONFIG: LOG_ASYNC = %d", config->log_async);
+    log_message("CONFIG: TRACE = %d", config->trace);
+    log_message("CONFIG: STATS_INTERVAL = %d", config->stats_interval);
+    log_message("CONFIG: TX_POOL_SHARDS = %d", config->tx_pool_shards);
+    log_message("CONFIG: LEDGER_GROUP_COMMIT = %d", config->ledger_group_commit);
+    log_message("CONFIG: ACCOUNT_TABLE_SIZE = %d", config->account_table_size);
+    log_message("CONFIG: ACCOUNT_INITIAL_BALANCE = %lld", (long long)config->account_initial_balance);
+    log_message("CONFIG: VALIDATOR_THREADS = %d", config->validator_threads);
+} 
+
+// Função para abrir a memória compartilhada da tx_pool (sem criá-la)
+void open_tx_pool_memory() {
+    // Get the size from the config (no fstat needed)
+    size_t total_size = tx_pool_size(global_config.pool_size, global_config.tx_pool_shards);
+
+    // Open existing shared memory (no creation)
+    tx_pool_fd = shm_open(TX_POOL_SHM, O_RDWR, 0666);
+    if (tx_pool_fd == -1) {
+        log_message("ERROR: shm_open failed for %s", TX_POOL_SHM);
+        exit(EXIT_FAILURE);
+    }
+
+    // Map the memory using the precomputed size
+    tx_pool_ptr = mmap(NULL, total_size, PROT_READ | PROT_WRITE, 
+                       MAP_SHARED, tx_pool_fd, 0);
+    if (tx_pool_ptr == MAP_FAILED) {
+        log_message("ERROR: mmap failed for %s", TX_POOL_SHM);
+        exit(EXIT_FAILURE);
+    }
+
+    LOG_INFO(LOG_CAT_SHM, "SHM: tx_pool opened and mapped (size based on config)");
+}
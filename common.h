@@ -2,6 +2,8 @@
 #define STRUCTS_H
 
 #include <time.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <stdio.h>   // fopen, fscanf, fclose
 #include <stdlib.h>  // exit
 #include <string.h>
@@ -9,18 +11,29 @@
 
 // SHM Names
 #define TX_POOL_SHM "/tx_pool_shm"
-#define BLOCKCHAIN_SHM "/blockchain_shm"
-#define VALIDATOR_FIFO "/tmp/validator_fifo"
 
 #define TX_ID_LEN 64
 #define TXB_ID_LEN 64
 #define HASH_SIZE 65  // SHA256_DIGEST_LENGTH * 2 + 1
+#define MERKLE_ROOT_SIZE 32  // SHA-256 da árvore de Merkle das transações (ver merkle.h)
+#define CACHE_LINE_SIZE 64
  
 typedef struct {
     int num_miners;
     int pool_size;
     int transactions_per_block;
     int blockchain_blocks;
+    int pow_difficulty;      // Opcional: POW_DIFFICULTY <n> (dígitos hex a zero)
+    int miner_team_size;     // Opcional: MINER_TEAM_SIZE <n> (threads por bloco candidato)
+    int tx_lease_seconds;    // Opcional: TX_LEASE_SECONDS <n> (validade da reserva de um miner)
+    int log_async;           // Opcional: LOG_ASYNC 0|1 (rings em memória partilhada + flusher)
+    int trace;               // Opcional: TRACE 0|1 (trace binário em TRACE_FILE)
+    int stats_interval;      // Opcional: STATS_INTERVAL <s> (período dos relatórios do Statistics)
+    int tx_pool_shards;      // Opcional: TX_POOL_SHARDS <n> (0 = automático; valor efetivo após load_config)
+    int ledger_group_commit; // Opcional: LEDGER_GROUP_COMMIT <n> (blocos por sync do ledger)
+    int account_table_size;  // Opcional: ACCOUNT_TABLE_SIZE <n> (contas distintas na tabela de saldos)
+    int64_t account_initial_balance; // Opcional: ACCOUNT_INITIAL_BALANCE <n> (saldo de uma conta nova)
+    int validator_threads;   // Opcional: VALIDATOR_THREADS <n> (0 = um por CPU; valor efetivo após load_config)
 } Config;
 
 // Transação na transaction pool
@@ -30,42 +43,149 @@ typedef struct {
     int sender_id;
     int receiver_id;
     int value;
-    time_t timestamp;
+    uint64_t timestamp;   // CLOCK_MONOTONIC em ns, na criação (base das latências ponta a ponta)
     int age;
     int empty; // 1 = vazio, 0 = ocupado
 } Transaction;
 
+// Bloco de tamanho fixo e sem ponteiros: cabeçalho seguido do array de transações inline.
+// O tamanho real depende de transactions_per_block (ver get_transaction_block_size()),
+// por isso um bloco nunca é declarado na stack nem copiado com sizeof(TransactionBlock).
 typedef struct {
   char txb_id[TXB_ID_LEN];              // Unique block ID (e.g., ThreadID + #)
   char previous_block_hash[HASH_SIZE];  // Hash of the previous block
   time_t timestamp;                     // Time when block was created
-  Transaction* transactions;  // Array de transações
+  uint8_t merkle_root[MERKLE_ROOT_SIZE]; // Raiz das transações; o PoW cobre a raiz, não o array
   unsigned int nonce;                   // PoW solution
+  _Alignas(CACHE_LINE_SIZE) Transaction transactions[];  // transactions_per_block entradas
 } TransactionBlock;
 
+#define LEDGER_HEADER_SIZE 4096
+
+// Cadeia de blocos, mapeada do ficheiro do ledger (ver ledger.h): cabeçalho seguido de
+// um anel de `capacity` registos de `record_size` bytes (o bloco e o trailer com o
+// checksum). A altura h ocupa o slot h % capacity; os blocos mais antigos do que a
+// janela estão no arquivo comprimido (ver archive.h)
+typedef struct {
+    char magic[8];               // LEDGER_MAGIC
+    uint32_t version;
+    int transactions_per_block;  // Formato dos registos; tem de coincidir com a configuração
+    int capacity;          // Tamanho da janela em memória (blockchain_blocks)
+    int segment_blocks;    // Blocos por segmento do arquivo
+    uint64_t block_count;  // Altura da cadeia (blocos já escritos)
+    size_t block_size;     // get_transaction_block_size() no momento da criação
+    size_t record_size;    // Passo entre blocos
+    _Atomic uint64_t synced_count;    // Registos já em disco (último group commit)
+    _Atomic uint64_t archived_count;  // Blocos já no arquivo; os seus slots podem ser reutilizados
+    int max_tx_id;         // Maior id de transação na cadeia (0 em ledgers anteriores); seed dos ids da pool
+    _Alignas(LEDGER_HEADER_SIZE) unsigned char blocks[];
+} Blockchain;
+
 
 typedef struct {
     void *ptr;
     int fd;
 } SharedMemory;
 
+#define TX_REWARD_LEVELS 3   // Rewards válidas: 1..TX_REWARD_LEVELS
+
+// Fila FIFO limitada (multi-produtor/multi-consumidor) de índices de slots com a mesma reward.
+// As células ficam depois da pool, em cells_offset.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t enqueue_pos;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t dequeue_pos;
+    size_t cells_offset;
+    uint64_t mask;                       // capacidade - 1 (potência de 2)
+} TxRewardBucket;
+
+#define TX_POOL_MAX_SHARDS 16
+
+// Partição da pool: slots [s * shard_slots, (s + 1) * shard_slots) com pilha de livres,
+// filas por reward e contagem de prontos próprias, cada uma na sua cache line.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t free_head;   // (tag << 32) | (slot + 1), 0 = vazia
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t ready_count; // Slots READY deste shard
+    TxRewardBucket reward_buckets[TX_REWARD_LEVELS];         // Índice de prioridade por reward
+} TxPoolShard;
+
+// Parte fria de uma transação pendente: só é lida quando a transação entra num bloco
+typedef struct {
+    uint64_t timestamp;
+    int sender_id;
+    int receiver_id;
+    int value;
+} TxPayload;
+
+// Transações pendentes em structure-of-arrays, por offset a partir do início da pool.
+// Os scans só tocam no bitmap e nos arrays quentes (4 + 1 + 4 bytes por slot);
+// o payload só é lido quando a transação é reclamada para um bloco.
+typedef struct {
+    size_t occupancy_offset;   // _Atomic uint64_t[]: 1 bit por slot não vazio (WRITING, READY ou CLAIMED)
+    size_t id_offset;          // int32_t[pool_size]
+    size_t reward_offset;      // uint8_t[pool_size]
+    size_t age_offset;         // int32_t[pool_size]
+    size_t payload_offset;     // TxPayload[pool_size]
+} TxPendingSet;
+
+// Pool lock-free em TX_POOL_SHM (ver tx_pool.h). As transações e os arrays auxiliares
+// vivem depois do cabeçalho e são acedidos por offset, como os blocos da blockchain.
 typedef struct {
+    _Atomic uint32_t hash_seq;           // Seqlock de current_block_hash (ímpar = escrita em curso)
     char current_block_hash[HASH_SIZE];
     int pool_size; 
-    Transaction transactions_pending_set[]; // Flexible array 
+    size_t slot_state_offset;            // _Atomic uint64_t[pool_size]: estado de cada slot
+    size_t free_next_offset;             // _Atomic uint32_t[pool_size]: ligações da pilha de slots livres
+    size_t ready_bitmap_offset;          // _Atomic uint64_t[]: 1 bit por slot pronto a ser reclamado
+    size_t id_index_offset;              // _Atomic uint64_t[1 << id_index_bits]: tabela id -> slot
+    int id_index_bits;
+    int lease_seconds;                   // Duração das reservas (claims) dos miners
+    int shard_count;
+    int shard_slots;                     // Slots por shard (o último pode ter menos)
+    uint32_t block_threshold;            // transactions_per_block
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t ready_seq;   // Futex: incrementado para acordar os miners
+    _Atomic uint32_t ready_waiters;      // Miners bloqueados em ready_seq
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t space_seq;   // Futex: incrementado quando um slot fica livre
+    _Atomic uint32_t space_waiters;      // Produtores bloqueados em space_seq (pool cheia)
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tx_id_seq;   // Ids já atribuídos (ver tx_pool_reserve_ids)
+    TxPoolShard shards[TX_POOL_MAX_SHARDS];
+    TxPendingSet transactions_pending_set;
 } TransactionPool;
 
-Config global_config;
+extern Config global_config;
 extern size_t transactions_per_block;
 extern int tx_pool_fd;         // Declare as extern
 extern TransactionPool* tx_pool_ptr;      // Declare as extern
+extern Blockchain* blockchain_ptr;
 
 // Function declaration
 void load_config(const char *filename, Config *config);
-int open_fifo(const char* fifo_path, int mode);
-void close_fifo(int fifo_fd, const char* fifo_path);
 void open_tx_pool_memory();
-//static inline size_t get_transaction_block_size();
+
+// Tamanho de um bloco com transactions_per_block transações, arredondado à cache line
+// para que blocos consecutivos fiquem alinhados
+static inline size_t get_transaction_block_size() {
+  if (transactions_per_block == 0) {
+    perror("Must set the 'transactions_per_block' variable before using!\n");
+    exit(-1);
+  }
+  size_t size = sizeof(TransactionBlock) + transactions_per_block * sizeof(Transaction);
+  return (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+}
+
+// Registo do ledger: o bloco e uma cache line para o trailer (LedgerRecordTrailer)
+static inline size_t get_ledger_record_size() {
+  return get_transaction_block_size() + CACHE_LINE_SIZE;
+}
+
+static inline size_t get_blockchain_size(int capacity) {
+  return sizeof(Blockchain) + (size_t)capacity * get_ledger_record_size();
+}
+
+// Slot de uma altura na janela, por offset: válido em qualquer processo, seja qual for o
+// endereço do mapeamento. Só é o bloco pedido se a altura ainda estiver na janela
+static inline TransactionBlock* blockchain_block_at(Blockchain* chain, uint64_t height) {
+  return (TransactionBlock*)(chain->blocks + (size_t)(height % (uint64_t)chain->capacity) * chain->record_size);
+}
 
 
 #endif
\ No newline at end of file
@@ -9,32 +9,29 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <errno.h>
-#include <semaphore.h>
 #include "logging.h"
 #include "common.h"
 #include "miner.h"
 #include "validator.h"
+#include "block_ring.h"
+#include "tx_pool.h"
+#include "trace.h"
+#include "stats.h"
+#include "ledger.h"
+#include "pow.h"
+#include "accounts.h"
 
 #define TX_POOL_SHM "/tx_pool_shm"
-#define BLOCKCHAIN_SHM "/blockchain_shm"
-#define NUM_SEMAPHORES 3
 
-int blockchain_fd = -1;
-void* blockchain_ptr = NULL;
+int block_ring_fd = -1;
+BlockRing* block_ring_ptr = NULL;
+AccountTable* account_table_ptr = NULL;
 
 volatile sig_atomic_t shutdown_requested = 0;
 static pid_t miner_pid = -1;
 static pid_t validator_pid = -1;
 static pid_t statistics_pid = -1;
 
-typedef struct {
-    sem_t* handle;
-    const char* name;
-} NamedSemaphore;
-
-NamedSemaphore semaphores[NUM_SEMAPHORES];
-int semaphore_count = 0;
-
 typedef void (*ProcessFunctionWithArgs)(void *);
 
 // Signal handler for SIGINT
@@ -56,32 +53,10 @@ void handle_sigint(int sig) {
     }
 }
 
-int create_named_semaphore(const char* name, unsigned int initial_value){
-    sem_t* sem = sem_open(name, O_CREAT, 0666, initial_value);
-    if (sem == SEM_FAILED) {
-        perror("Erro ao criar semáforo");
-        return -1;
-    }
-
-    semaphores[semaphore_count].handle = sem;
-    semaphores[semaphore_count].name = name;
-    semaphore_count++;
-
-    return 0;
-}
-
-void cleanup_named_semaphores() {
-    for (int i = 0; i < NUM_SEMAPHORES; i++) {
-        sem_close(semaphores[i].handle);
-        sem_unlink(semaphores[i].name);
-    }
-    semaphore_count = 0;
-}
-
 // Funções auxiliares
 static void safe_munmap(void* addr, size_t size, const char* name) {
     if (addr && munmap(addr, size) == 0) {
-        log_message("SHM: %s unmapped successfully", name);
+        LOG_INFO(LOG_CAT_SHM, "SHM: %s unmapped successfully", name);
     } else {
         log_message("ERROR: Failed to unmap %s", name);
     }
@@ -89,7 +64,7 @@ static void safe_munmap(void* addr, size_t size, const char* name) {
 
 static void safe_close(int fd, const char* name) {
     if (fd != -1 && close(fd) == 0) {
-        log_message("SHM: %s descriptor closed successfully", name);
+        LOG_INFO(LOG_CAT_SHM, "SHM: %s descriptor closed successfully", name);
     } else {
         log_message("ERROR: Failed to close descriptor for %s", name);
     }
@@ -97,7 +72,7 @@ static void safe_close(int fd, const char* name) {
 
 static void safe_unlink(const char* name) {
     if (shm_unlink(name) == 0) {
-        log_message("SHM: %s unlinked successfully", name);
+        LOG_INFO(LOG_CAT_SHM, "SHM: %s unlinked successfully", name);
     } else {
         log_message("ERROR: Failed to unlink %s", name);
     }
@@ -122,138 +97,138 @@ SharedMemory create_shared_memory(const char* name, size_t size) {
         exit(EXIT_FAILURE);
     }
 
-    log_message("SHM: %s created and mapped (%zu bytes)", name, size);
+    LOG_INFO(LOG_CAT_SHM, "SHM: %s created and mapped (%zu bytes)", name, size);
     return shm;
 }
 
 void create_tx_pool_memory(const Config* config) {
-    // Calculate total size: struct + transactions
-    size_t total_size = sizeof(TransactionPool) + sizeof(Transaction) * config->pool_size;
+    // Calculate total size: struct + transactions + lock-free metadata
+    size_t total_size = tx_pool_size(config->pool_size, config->tx_pool_shards);
 
     // Create shared memory
     SharedMemory shm = create_shared_memory(TX_POOL_SHM, total_size);
     tx_pool_ptr = shm.ptr;
     tx_pool_fd = shm.fd;
 
-    // Initialize the TransactionPool
-    TransactionPool* pool = (TransactionPool*)tx_pool_ptr;
-    pool->pool_size = config->pool_size; 
-    memset(pool->current_block_hash, '0', HASH_SIZE - 1);
-    pool->current_block_hash[HASH_SIZE - 1] = '\0';
-
-    // Initialize all slots as empty
-    for (int i = 0; i < config->pool_size; i++) {
-        pool->transactions_pending_set[i].empty = 1;
-    }
+    // Initialize the TransactionPool (all slots empty and on the free stack)
+    tx_pool_init(tx_pool_ptr, config->pool_size, config->tx_pool_shards, config->transactions_per_block,
+                 config->tx_lease_seconds);
 
-    log_message("SHM: tx_pool initialized with %d slots", config->pool_size);
+    LOG_INFO(LOG_CAT_SHM, "SHM: tx_pool initialized with %d slots in %d shards", config->pool_size,
+             config->tx_pool_shards);
 }
 
-// Inicialização da blockchain
+// Blockchain: o ledger em disco, mapeado em memória (janela dos últimos BLOCKCHAIN_BLOCKS
+// blocos; os anteriores vão para o arquivo). Se já existir é recuperado e a cadeia
+// continua a partir do último bloco.
 void create_blockchain_memory(const Config* config) {
-    // Calcular o tamanho de um bloco (baseado no número de transações por bloco)
-    size_t block_size = sizeof(TransactionBlock) + sizeof(Transaction) * config->transactions_per_block;
-
-    // Calcular o tamanho total da blockchain
-    size_t blockchain_size = block_size * config->blockchain_blocks;
-
-    // Criar a memória compartilhada para a blockchain
-    SharedMemory shm = create_shared_memory(BLOCKCHAIN_SHM, blockchain_size);
-    blockchain_ptr = shm.ptr;
-    blockchain_fd = shm.fd;
+    blockchain_ptr = ledger_open(LEDGER_FILE, config);
+
+    // Os ids novos continuam depois dos que já estão na cadeia
+    tx_pool_seed_ids(tx_pool_ptr, blockchain_ptr->max_tx_id);
+
+    if (blockchain_ptr->block_count > 0) {
+        char tip_hash[HASH_SIZE];
+        pow_block_hash(blockchain_block_at(blockchain_ptr, blockchain_ptr->block_count - 1), tip_hash);
+        tx_pool_set_current_hash(tx_pool_ptr, tip_hash);
+        LOG_INFO(LOG_CAT_LEDGER, "LEDGER: chain resumes at height %llu (hash %s)",
+                 (unsigned long long)blockchain_ptr->block_count,
+                 tip_hash);
+    }
+}
 
-    // Inicializar blocos na memória
-    for (int i = 0; i < config->blockchain_blocks; i++) {
-        // Achar o ponteiro para o bloco i na memória compartilhada
-        TransactionBlock* block = (TransactionBlock*)((char*)blockchain_ptr + i * block_size);
+// Tabela de saldos: o ficheiro ACCOUNT_TABLE_FILE, mapeado como o ledger. Só os blocos
+// que a tabela ainda não tem (normalmente nenhum) são aplicados; depois disso o validator
+// mantém-na bloco a bloco. Pode mudar os parâmetros da tabela em `config` (ver accounts.h)
+void create_account_table_memory(Config* config) {
+    account_table_ptr = account_table_open(ACCOUNT_TABLE_FILE, config, blockchain_ptr->block_count);
 
-        // Inicializar o nonce (inicialmente 0)
-        block->nonce = 0;
+    uint64_t from = atomic_load(&account_table_ptr->applied_height);
+    uint64_t height = blockchain_ptr->block_count;
+    if (from == height) {
+        return;
+    }
 
-        // Alocar memória para o array de transações (transactions_per_block)
-        block->transactions = (Transaction*)malloc(sizeof(Transaction) * config->transactions_per_block);
-        if (block->transactions == NULL) {
-            log_message("ERROR: malloc failed for transactions in block %d", i);
+    AccountBatch batch;
+    TransactionBlock* block = malloc(blockchain_ptr->block_size);
+    if (block == NULL) {
+        log_message("ERROR: Cannot allocate the account replay buffer");
+        exit(EXIT_FAILURE);
+    }
+    account_batch_attach(&batch, account_table_ptr);
+    for (uint64_t h = from; h < height; h++) {
+        if (ledger_read_block(blockchain_ptr, h, block) != 0 ||
+            account_apply_block(account_table_ptr, block, config->transactions_per_block, &batch) != 0) {
+            log_message("ERROR: Cannot apply block %llu to the account table; move %s away to rebuild it",
+                        (unsigned long long)h, ACCOUNT_TABLE_FILE);
             exit(EXIT_FAILURE);
         }
-
-        // Inicializar as transações no bloco
-        for (int j = 0; j < config->transactions_per_block; j++) {
-            block->transactions[j].empty = 1;  // Marcar todas as transações como vazias
-        }
+        account_commit(account_table_ptr, &batch);
     }
+    free(block);
+    LOG_INFO(LOG_CAT_LEDGER, "LEDGER: %llu block(s) applied to the account table (%llu accounts)",
+             (unsigned long long)(height - from), (unsigned long long)atomic_load(&account_table_ptr->accounts));
+}
 
-    log_message("SHM: Blockchain created and mapped successfully with %zu blocks", config->blockchain_blocks);
+// Ring de slots de blocos partilhado entre miners e validator
+void create_block_ring_memory() {
+    SharedMemory shm = create_shared_memory(BLOCK_RING_SHM, block_ring_size(BLOCK_RING_SLOTS));
+    block_ring_ptr = shm.ptr;
+    block_ring_fd = shm.fd;
+
+    block_ring_init(block_ring_ptr, BLOCK_RING_SLOTS);
+    LOG_INFO(LOG_CAT_SHM, "SHM: block ring initialized with %d slots", BLOCK_RING_SLOTS);
 }
 
 // Unmap and unlink shared memory
 void cleanup_shared_memory() {
     // Desfazer mappings
-    size_t tx_pool_size = sizeof(TransactionPool) + sizeof(Transaction) * global_config.pool_size;
-    size_t blockchain_size = sizeof(TransactionBlock) * global_config.blockchain_blocks;
-
-    // Liberar memória alocada dinamicamente para transações em cada bloco da blockchain
-    TransactionBlock* blockchain = (TransactionBlock*)blockchain_ptr;
-    for (int i = 0; i < global_config.blockchain_blocks; i++) {
-        if (blockchain[i].transactions != NULL) {
-            free(blockchain[i].transactions);  // Liberar o array de transações do bloco
-        }
-    }
+    size_t tx_pool_bytes = tx_pool_size(global_config.pool_size, global_config.tx_pool_shards);
 
     // Desalocar a memória compartilhada
-    safe_munmap(tx_pool_ptr, tx_pool_size, "tx_pool");
-    safe_munmap(blockchain_ptr, blockchain_size, "blockchain");
+    safe_munmap(tx_pool_ptr, tx_pool_bytes, "tx_pool");
+    safe_munmap(block_ring_ptr, block_ring_size(BLOCK_RING_SLOTS), "block_ring");
 
     // Fechar descritores
     safe_close(tx_pool_fd, "tx_pool");
-    safe_close(blockchain_fd, "blockchain");
+    safe_close(block_ring_fd, "block_ring");
 
     // Remover objetos de memória
     safe_unlink(TX_POOL_SHM);
-    safe_unlink(BLOCKCHAIN_SHM);
-}
+    safe_unlink(BLOCK_RING_SHM);
 
-void create_named_pipe() {
-        if (mkfifo(VALIDATOR_FIFO, O_CREAT|O_EXCL|0600)<0){
-            if (errno != EEXIST) {
-                log_message("ERROR: Failed to create FIFO %s: %s", VALIDATOR_FIFO, strerror(errno));
-                exit(0);
-            } else {
-                log_message("INFO: FIFO %s already exists", VALIDATOR_FIFO);
-            }
-        } else {
-            log_message("INFO: FIFO %s created successfully", VALIDATOR_FIFO);
-        }
-}
+    close_stats_memory(1);
 
-void cleanup_named_pipe(){
-    if(unlink(VALIDATOR_FIFO) == 0){
-        log_message("INFO: FIFO %s removed successfully", VALIDATOR_FIFO);
-    } else {
-        if (errno == ENOENT){
-            log_message("INFO: FIFO %s already removed or not found", VALIDATOR_FIFO);
-        } else {
-            log_message("ERROR: Failed to unlink FIFO %s: %s", VALIDATOR_FIFO, strerror(errno));
-        }
-    }
+    // O ledger e a tabela de saldos ficam: footer e clean para o próximo arranque não
+    // ter de validar a cauda nem reconstruir os saldos
+    ledger_close(blockchain_ptr, 1);
+    blockchain_ptr = NULL;
+    account_table_close(account_table_ptr, 1);
+    account_table_ptr = NULL;
 }
 
 void print_tx_pool(TransactionPool* pool, int pool_size) {
+    char current_hash[HASH_SIZE];
+    tx_pool_get_current_hash(pool, current_hash);
+
     printf("\n=== Conteúdo da Transaction Pool ===\n");
-    printf("Current Block ID: %s\n", pool->current_block_hash);
+    printf("Current Block ID: %s\n", current_hash);
+    printf("Ocupação: %d/%d slots\n", tx_pool_occupied(pool), pool_size);
     for (int i = 0; i < pool_size; i++) {
-        Transaction* t = &pool->transactions_pending_set[i];
-        if (t->empty) {
+        int state = tx_pool_slot_state(pool, i);
+        if (state != TX_SLOT_READY && state != TX_SLOT_CLAIMED) {
             printf("[Slot %d] VAZIO\n", i);
         } else {
-            printf("[Slot %d] ID=%d | From=%d | To=%d | Value=%d | Reward=%d | Aging=%d\n",
-                   i,
-                   t->id,
-                   t->sender_id,
-                   t->receiver_id,
-                   t->value,
-                   t->reward,
-                   t->age);
+            Transaction t;
+            tx_pool_read_slot(pool, i, &t);
+            printf("[Slot %d]%s ID=%d | From=%d | To=%d | Value=%d | Reward=%d | Aging=%d\n",
+                   i, state == TX_SLOT_CLAIMED ? " (em bloco)" : "",
+                   t.id,
+                   t.sender_id,
+                   t.receiver_id,
+                   t.value,
+                   t.reward,
+                   t.age);
         }
     }
     printf("=====================================\n");
@@ -270,6 +245,10 @@ void run_validator_process_wrapper(void *arg) {
     listen_for_blocks(config);
 }
 
+void run_statistics_process_wrapper(void *arg) {
+    run_statistics_process((Config*)arg);
+}
+
 // Create process and call the given function
 pid_t create_process(const char *name, ProcessFunctionWithArgs func, void *args) {
     pid_t pid = fork();
@@ -296,18 +275,27 @@ int main() {
     signal(SIGINT, handle_sigint);
 
     log_init("DEIChain_log.txt");
+    log_install_level_signals();   // kill -USR1/-USR2 <pid do controller>
     load_config("config.cfg", &global_config);
+    if (global_config.trace) {
+        trace_open(TRACE_FILE, 1);   // Os filhos herdam o descritor (O_APPEND)
+    }
  
     create_tx_pool_memory(&global_config);
     create_blockchain_memory(&global_config);
-    create_named_semaphore("/sem_mutex", 1);
-    create_named_semaphore("/sem_empty", global_config.pool_size);
-    create_named_semaphore("/sem_full", 0);
-    create_named_pipe();
+    create_account_table_memory(&global_config);
+    create_block_ring_memory();
+    create_stats_memory();
+    if (global_config.log_async) {
+        log_create_async();
+    }
 
     miner_pid = create_process("Miner", run_miner_process_wrapper, &global_config.num_miners);
-    validator_pid = create_process("Validator", NULL, NULL);
-    statistics_pid = create_process("Statistics", NULL, NULL);
+    validator_pid = create_process("Validator", run_validator_process_wrapper, &global_config);
+    statistics_pid = create_process("Statistics", run_statistics_process_wrapper, &global_config);
+
+    // Só depois dos fork(): os filhos não herdam a thread do flusher
+    log_start_flusher();
 
     // Main loop: wait for SIGINT
     while (!shutdown_requested) {
@@ -320,9 +308,8 @@ int main() {
     waitpid(validator_pid, NULL, 0);
     waitpid(statistics_pid, NULL, 0);
 
-    cleanup_named_semaphores();
     cleanup_shared_memory();
-    cleanup_named_pipe();
+    trace_close();
     log_message("INFO: System shut down successfully");
     log_close();
 
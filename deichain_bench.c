@@ -0,0 +1,374 @@
+// deichain-bench: benchmark ponta a ponta. Arranca o controller com um config.cfg,
+// lança produtores txgen a ritmo fixo, mede uma janela de tempo (ou de transações)
+// através de /stats_shm e escreve o resultado em JSON.
+//
+//   deichain-bench [-c config] [-p produtores] [-s sleep_ms | -r tx/s] [-d segundos] [-n transações]
+//                  [-W aquecimento_s] [-w diretório] [-b bindir] [-l etiqueta] [-o ficheiro]
+//
+// Com -r os produtores correm no modo gerador de carga do txgen (chegadas constantes,
+// ritmo total repartido pelos produtores); sem -r usam o modo clássico com sleep_ms.
+//
+// Tudo corre dentro do diretório de trabalho (por omissão bench_run/), para que o log e o
+// trace de uma execução nunca se misturem com os de uma execução manual.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "common.h"
+#include "stats.h"
+#include "trace.h"
+#include "ledger.h"
+#include "archive.h"
+#include "accounts.h"  // ACCOUNT_TABLE_FILE
+
+#define BENCH_MAX_PRODUCERS 64
+#define BENCH_POLL_MS 100
+#define BENCH_ATTACH_TIMEOUT_MS 5000
+
+typedef struct {
+    const char* config_path;
+    const char* workdir;
+    const char* bindir;
+    const char* label;
+    const char* output;
+    int producers;
+    int sleep_ms;
+    double rate;           // tx/s de todos os produtores; 0 = modo clássico
+    int duration_s;
+    int warmup_s;
+    long tx_target;
+} BenchOptions;
+
+// Retrato dos contadores e histogramas num instante
+typedef struct {
+    uint64_t ns;
+    StatsTotals totals;
+    uint64_t buckets[LAT_STAGE_COUNT][LATENCY_BUCKETS];
+    uint64_t sum_ns[LAT_STAGE_COUNT];
+} BenchSnapshot;
+
+static const char* stage_keys[LAT_STAGE_COUNT] = {
+    [LAT_POOL_WAIT] = "pool_wait",
+    [LAT_ASSEMBLY] = "assembly",
+    [LAT_POW] = "pow",
+    [LAT_VALIDATION] = "validation",
+    [LAT_COMMIT] = "commit",
+    [LAT_END_TO_END] = "end_to_end",
+};
+
+static volatile sig_atomic_t bench_interrupted = 0;
+static BenchSnapshot window_start, window_end;
+
+static void handle_sigint_bench(int sig) {
+    (void)sig;
+    bench_interrupted = 1;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void take_snapshot(BenchSnapshot* snap) {
+    snap->ns = trace_now_ns();
+    stats_collect(&snap->totals);
+    for (int s = 0; s < LAT_STAGE_COUNT; s++) {
+        LatencyHistogram* h = &stats_ptr->latency[s];
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            snap->buckets[s][b] = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+        }
+        snap->sum_ns[s] = atomic_load_explicit(&h->sum_ns, memory_order_relaxed);
+    }
+}
+
+static uint64_t committed_since(const BenchSnapshot* start) {
+    LatencyHistogram* h = &stats_ptr->latency[LAT_END_TO_END];
+    uint64_t before = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        before += start->buckets[LAT_END_TO_END][b];
+    }
+    return atomic_load_explicit(&h->count, memory_order_relaxed) - before;
+}
+
+// Processo filho com stdout/stderr num ficheiro do diretório de trabalho
+static pid_t spawn(const char* output, char* const argv[]) {
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+
+    int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+    signal(SIGINT, SIG_DFL);
+    execv(argv[0], argv);
+    fprintf(stderr, "ERROR: exec %s failed: %s\n", argv[0], strerror(errno));
+    _exit(127);
+}
+
+static void stop_process(pid_t pid) {
+    if (pid > 0) {
+        kill(pid, SIGINT);
+        waitpid(pid, NULL, 0);
+    }
+}
+
+static int copy_file(const char* from, const char* to) {
+    FILE* in = fopen(from, "rb");
+    if (in == NULL) {
+        return -1;
+    }
+    FILE* out = fopen(to, "wb");
+    if (out == NULL) {
+        fclose(in);
+        return -1;
+    }
+
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        fwrite(buf, 1, n, out);
+    }
+    fclose(in);
+    return fclose(out);
+}
+
+// O controller cria /stats_shm antes dos fork(); até lá o segmento não existe
+static int attach_stats(pid_t controller) {
+    for (int waited = 0; waited < BENCH_ATTACH_TIMEOUT_MS; waited += BENCH_POLL_MS) {
+        if (waitpid(controller, NULL, WNOHANG) == controller) {
+            return -1;
+        }
+        open_stats_memory();
+        if (stats_ptr != NULL) {
+            return 0;
+        }
+        sleep_ms(BENCH_POLL_MS);
+    }
+    return -1;
+}
+
+static void write_stage_json(FILE* out, int stage) {
+    static uint64_t delta[LATENCY_BUCKETS];
+    uint64_t count = 0;
+    int last = -1;
+
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        delta[b] = window_end.buckets[stage][b] - window_start.buckets[stage][b];
+        count += delta[b];
+        if (delta[b] != 0) {
+            last = b;
+        }
+    }
+
+    uint64_t sum = window_end.sum_ns[stage] - window_start.sum_ns[stage];
+    fprintf(out, "    \"%s\": {\"count\": %llu, \"mean\": %llu, \"p50\": %llu, \"p99\": %llu, "
+            "\"p999\": %llu, \"max\": %llu}",
+            stage_keys[stage], (unsigned long long)count,
+            (unsigned long long)(count > 0 ? sum / count : 0),
+            (unsigned long long)stats_latency_percentile(delta, count, 0.50),
+            (unsigned long long)stats_latency_percentile(delta, count, 0.99),
+            (unsigned long long)stats_latency_percentile(delta, count, 0.999),
+            (unsigned long long)(last >= 0 ? latency_bucket_high(last) : 0));
+}
+
+static void write_json(FILE* out, const BenchOptions* opt) {
+    const StatsTotals* a = &window_start.totals;
+    const StatsTotals* b = &window_end.totals;
+    double seconds = (double)(window_end.ns - window_start.ns) / 1e9;
+    uint64_t committed = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        committed += window_end.buckets[LAT_END_TO_END][i] - window_start.buckets[LAT_END_TO_END][i];
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"label\": \"%s\",\n", opt->label);
+    fprintf(out, "  \"config\": {\"num_miners\": %d, \"pool_size\": %d, \"transactions_per_block\": %d, "
+            "\"pow_difficulty\": %d, \"miner_team_size\": %d},\n",
+            global_config.num_miners, global_config.pool_size, global_config.transactions_per_block,
+            global_config.pow_difficulty, global_config.miner_team_size);
+    fprintf(out, "  \"producers\": %d,\n", opt->producers);
+    fprintf(out, "  \"producer_sleep_ms\": %d,\n", opt->rate > 0 ? 0 : opt->sleep_ms);
+    fprintf(out, "  \"target_tx_per_s\": %.1f,\n", opt->rate);
+    fprintf(out, "  \"interrupted\": %s,\n", bench_interrupted ? "true" : "false");
+    fprintf(out, "  \"duration_s\": %.3f,\n", seconds);
+    fprintf(out, "  \"tx_inserted\": %llu,\n", (unsigned long long)(b->tx_inserted - a->tx_inserted));
+    fprintf(out, "  \"tx_committed\": %llu,\n", (unsigned long long)committed);
+    fprintf(out, "  \"blocks_mined\": %llu,\n", (unsigned long long)(b->blocks_mined - a->blocks_mined));
+    fprintf(out, "  \"blocks_validated\": %llu,\n", (unsigned long long)(b->blocks_validated - a->blocks_validated));
+    fprintf(out, "  \"blocks_rejected\": %llu,\n", (unsigned long long)(b->blocks_rejected - a->blocks_rejected));
+    fprintf(out, "  \"tx_per_s\": %.3f,\n", seconds > 0 ? committed / seconds : 0.0);
+    fprintf(out, "  \"blocks_per_s\": %.3f,\n", seconds > 0 ? (b->blocks_validated - a->blocks_validated) / seconds : 0.0);
+    fprintf(out, "  \"hashes_per_s\": %.1f,\n", seconds > 0 ? (b->hashes - a->hashes) / seconds : 0.0);
+    fprintf(out, "  \"latency_ns\": {\n");
+    for (int s = 0; s < LAT_STAGE_COUNT; s++) {
+        write_stage_json(out, s);
+        fprintf(out, s + 1 < LAT_STAGE_COUNT ? ",\n" : "\n");
+    }
+    fprintf(out, "  }\n}\n");
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-c config] [-p producers] [-s sleep_ms | -r tx/s] [-d seconds] [-n transactions]\n"
+            "          [-W warmup_s] [-w workdir] [-b bindir] [-l label] [-o output.json]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt = {
+        .config_path = "config.cfg", .workdir = "bench_run", .bindir = ".", .label = "",
+        .output = NULL, .producers = 4, .sleep_ms = 200, .rate = 0, .duration_s = 20, .warmup_s = 2, .tx_target = 0,
+    };
+    int c;
+
+    while ((c = getopt(argc, argv, "c:p:s:r:d:n:W:w:b:l:o:")) != -1) {
+        switch (c) {
+        case 'c': opt.config_path = optarg; break;
+        case 'p': opt.producers = atoi(optarg); break;
+        case 's': opt.sleep_ms = atoi(optarg); break;
+        case 'r': opt.rate = atof(optarg); break;
+        case 'd': opt.duration_s = atoi(optarg); break;
+        case 'n': opt.tx_target = atol(optarg); break;
+        case 'W': opt.warmup_s = atoi(optarg); break;
+        case 'w': opt.workdir = optarg; break;
+        case 'b': opt.bindir = optarg; break;
+        case 'l': opt.label = optarg; break;
+        case 'o': opt.output = optarg; break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (opt.producers < 1 || opt.producers > BENCH_MAX_PRODUCERS || opt.duration_s < 1 || opt.warmup_s < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Caminhos absolutos antes de mudar para o diretório de trabalho
+    char bindir[PATH_MAX], config[PATH_MAX], output[PATH_MAX];
+    char controller_bin[PATH_MAX + 16], txgen_bin[PATH_MAX + 16];
+    if (realpath(opt.bindir, bindir) == NULL || realpath(opt.config_path, config) == NULL) {
+        fprintf(stderr, "ERROR: cannot resolve %s or %s\n", opt.bindir, opt.config_path);
+        return EXIT_FAILURE;
+    }
+    if (opt.output != NULL && opt.output[0] != '/') {
+        if (getcwd(output, sizeof(output) - strlen(opt.output) - 2) == NULL) {
+            return EXIT_FAILURE;
+        }
+        strcat(output, "/");
+        strcat(output, opt.output);
+        opt.output = output;
+    }
+    snprintf(controller_bin, sizeof(controller_bin), "%s/controller", bindir);
+    snprintf(txgen_bin, sizeof(txgen_bin), "%s/txgen", bindir);
+
+    if ((mkdir(opt.workdir, 0755) == -1 && errno != EEXIST) || chdir(opt.workdir) == -1 ||
+        copy_file(config, "config.cfg") != 0) {
+        fprintf(stderr, "ERROR: cannot prepare work directory %s\n", opt.workdir);
+        return EXIT_FAILURE;
+    }
+    // O stdout fica só para o JSON; o eco do log na consola vai para bench.out
+    fflush(stdout);
+    int json_fd = dup(STDOUT_FILENO);
+    int console_fd = open("bench.out", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    FILE* json = json_fd != -1 ? fdopen(json_fd, "w") : NULL;
+    if (json == NULL || console_fd == -1 || dup2(console_fd, STDOUT_FILENO) == -1) {
+        fprintf(stderr, "ERROR: cannot redirect console output to %s/bench.out\n", opt.workdir);
+        return EXIT_FAILURE;
+    }
+    close(console_fd);
+
+    unlink("DEIChain_log.txt");
+    unlink(LEDGER_FILE);   // Cada medição começa com uma cadeia vazia
+    unlink(ARCHIVE_DATA_FILE);
+    unlink(ARCHIVE_INDEX_FILE);
+    unlink(ACCOUNT_TABLE_FILE);
+    log_init("DEIChain_log.txt");
+    load_config("config.cfg", &global_config);
+
+    signal(SIGINT, handle_sigint_bench);
+
+    char* controller_argv[] = { controller_bin, NULL };
+    pid_t controller = spawn("controller.out", controller_argv);
+    if (controller < 0 || attach_stats(controller) != 0) {
+        fprintf(stderr, "ERROR: controller did not start (see %s/controller.out)\n", opt.workdir);
+        stop_process(controller);
+        return EXIT_FAILURE;
+    }
+
+    // Rewards 1..3 alternados, para exercitar os três buckets da pool
+    pid_t producers[BENCH_MAX_PRODUCERS];
+    char sleep_arg[16], rate_arg[32];
+    snprintf(sleep_arg, sizeof(sleep_arg), "%d", opt.sleep_ms);
+    snprintf(rate_arg, sizeof(rate_arg), "%.3f", opt.rate / opt.producers);
+    for (int i = 0; i < opt.producers; i++) {
+        char reward_arg[4], out_name[32];
+        snprintf(reward_arg, sizeof(reward_arg), "%d", i % 3 + 1);
+        snprintf(out_name, sizeof(out_name), "txgen-%d.out", i);
+        if (opt.rate > 0) {
+            char* txgen_argv[] = { txgen_bin, "-r", rate_arg, "-a", "constant", "-w", reward_arg, NULL };
+            producers[i] = spawn(out_name, txgen_argv);
+        } else {
+            char* txgen_argv[] = { txgen_bin, reward_arg, sleep_arg, NULL };
+            producers[i] = spawn(out_name, txgen_argv);
+        }
+    }
+
+    if (opt.rate > 0) {
+        fprintf(stderr, "BENCH: %d producer(s) at %.1f tx/s in total", opt.producers, opt.rate);
+    } else {
+        fprintf(stderr, "BENCH: %d producer(s) every %d ms", opt.producers, opt.sleep_ms);
+    }
+    fprintf(stderr, ", warmup %d s, measuring %d s%s\n", opt.warmup_s, opt.duration_s,
+            opt.tx_target > 0 ? " or until the transaction target" : "");
+
+    // Aquecimento fora da janela: pool a encher, primeiros blocos, caches frias
+    for (int waited = 0; waited < opt.warmup_s * 1000 && !bench_interrupted; waited += BENCH_POLL_MS) {
+        sleep_ms(BENCH_POLL_MS);
+    }
+
+    take_snapshot(&window_start);
+    uint64_t deadline = window_start.ns + (uint64_t)opt.duration_s * 1000000000ull;
+    while (!bench_interrupted && trace_now_ns() < deadline) {
+        if (opt.tx_target > 0 && committed_since(&window_start) >= (uint64_t)opt.tx_target) {
+            break;
+        }
+        if (waitpid(controller, NULL, WNOHANG) == controller) {
+            fprintf(stderr, "ERROR: controller exited during the run\n");
+            controller = -1;
+            break;
+        }
+        sleep_ms(BENCH_POLL_MS);
+    }
+    take_snapshot(&window_end);
+
+    for (int i = 0; i < opt.producers; i++) {
+        stop_process(producers[i]);
+    }
+    stop_process(controller);
+
+    write_json(json, &opt);
+    fclose(json);
+    if (opt.output != NULL) {
+        FILE* out = fopen(opt.output, "w");
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: cannot write %s\n", opt.output);
+        } else {
+            write_json(out, &opt);
+            fclose(out);
+        }
+    }
+
+    close_stats_memory(0);
+    log_close();
+    return controller > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,191 @@
+// deichain-ledger: inspeciona o ledger (DEIChain_ledger.dat) e o arquivo comprimido
+// sem parar o controller.
+//
+//   deichain-ledger [-b altura] [-p altura:tx] [-v] [ficheiro]
+//     -b  mostra o bloco a essa altura (da janela ou do arquivo)
+//     -p  prova de inclusão da transação tx (posição no bloco) e a sua verificação
+//     -v  verifica o encadeamento de todos os blocos (hash anterior de cada um)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "ledger.h"
+#include "archive.h"
+#include "pow.h"
+#include "merkle.h"
+
+static Blockchain* map_ledger_readonly(const char* path, size_t* mapped) {
+    int fd = open(path, O_RDONLY);
+    Blockchain header;
+    if (fd == -1 || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        fprintf(stderr, "ERROR: cannot read %s\n", path);
+        return NULL;
+    }
+    if (memcmp(header.magic, LEDGER_MAGIC, sizeof(header.magic)) != 0 || header.version != LEDGER_VERSION) {
+        fprintf(stderr, "ERROR: %s is not a DEIChain ledger (version %u)\n", path, header.version);
+        close(fd);
+        return NULL;
+    }
+
+    *mapped = sizeof(Blockchain) + (size_t)header.capacity * header.record_size;
+    Blockchain* chain = mmap(NULL, *mapped, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (chain == MAP_FAILED) {
+        fprintf(stderr, "ERROR: mmap failed for %s\n", path);
+        return NULL;
+    }
+    transactions_per_block = (size_t)chain->transactions_per_block;
+    return chain;
+}
+
+static uint64_t file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+static void print_summary(const Blockchain* chain) {
+    uint64_t archived = atomic_load(&chain->archived_count);
+    uint64_t packed = file_size(ARCHIVE_DATA_FILE);
+
+    printf("height          %llu\n", (unsigned long long)chain->block_count);
+    printf("window          %d blocks of %zu bytes\n", chain->capacity, chain->record_size);
+    printf("synced          %llu\n", (unsigned long long)atomic_load(&chain->synced_count));
+    printf("archived        %llu blocks in %llu segments of %d\n", (unsigned long long)archived,
+           (unsigned long long)(archived / (uint64_t)chain->segment_blocks), chain->segment_blocks);
+    if (archived > 0 && packed > 0) {
+        double raw = (double)archived * (double)chain->block_size;
+        printf("archive size    %llu bytes (%.1fx compression)\n", (unsigned long long)packed, raw / (double)packed);
+    }
+}
+
+static void print_digest(const char* label, const uint8_t digest[SHA256_DIGEST_SIZE]) {
+    char hex[HASH_SIZE];
+    sha256_digest_to_hex(digest, hex);
+    printf("%s%s\n", label, hex);
+}
+
+static void print_block(const TransactionBlock* block, uint64_t height, int n_tx) {
+    char hash[HASH_SIZE];
+    pow_block_hash(block, hash);
+    printf("height %llu  id %s  nonce %u  timestamp %ld\n", (unsigned long long)height, block->txb_id,
+           block->nonce, (long)block->timestamp);
+    printf("  previous %s\n  hash     %s\n", block->previous_block_hash, hash);
+    print_digest("  merkle   ", block->merkle_root);
+    for (int i = 0; i < n_tx; i++) {
+        const Transaction* t = &block->transactions[i];
+        printf("  tx %d: reward %d, %d -> %d, value %d\n", t->id, t->reward, t->sender_id, t->receiver_id, t->value);
+    }
+}
+
+// Prova O(log n) de uma transação: o verificador só precisa dela, da prova e da raiz
+static int print_proof(const TransactionBlock* block, int n_tx, int index) {
+    MerkleProof proof;
+    if (merkle_proof(block->transactions, n_tx, index, &proof) != 0) {
+        fprintf(stderr, "ERROR: the block has no transaction %d\n", index);
+        return -1;
+    }
+    const Transaction* t = &block->transactions[index];
+    printf("proof for tx %d (position %d of %d, %d hashes)\n", t->id, index, n_tx, proof.depth);
+    for (int i = 0; i < proof.depth; i++) {
+        print_digest("  ", proof.siblings[i]);
+    }
+    int ok = merkle_verify(t, &proof, block->merkle_root);
+    printf("inclusion %s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : -1;
+}
+
+// Cada bloco tem de apontar para o hash do anterior, atravesse ou não a fronteira
+// entre o arquivo e a janela
+static int verify_chain(Blockchain* chain, TransactionBlock* block) {
+    char previous[HASH_SIZE] = "";
+    uint64_t count = chain->block_count;
+    for (uint64_t h = 0; h < count; h++) {
+        if (ledger_read_block(chain, h, block) != 0) {
+            fprintf(stderr, "ERROR: block %llu cannot be read\n", (unsigned long long)h);
+            return -1;
+        }
+        if (h > 0 && strncmp(block->previous_block_hash, previous, HASH_SIZE) != 0) {
+            fprintf(stderr, "ERROR: block %llu does not chain to block %llu\n", (unsigned long long)h,
+                    (unsigned long long)h - 1);
+            return -1;
+        }
+        if (!merkle_block_matches(block, chain->transactions_per_block)) {
+            fprintf(stderr, "ERROR: block %llu does not match its Merkle root\n", (unsigned long long)h);
+            return -1;
+        }
+        pow_block_hash(block, previous);
+    }
+    printf("chain OK: %llu blocks verified\n", (unsigned long long)count);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    long long show = -1;
+    long long prove = -1;
+    int prove_index = 0;
+    int verify = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:p:v")) != -1) {
+        switch (opt) {
+        case 'b':
+            show = atoll(optarg);
+            break;
+        case 'p':
+            if (sscanf(optarg, "%lld:%d", &prove, &prove_index) != 2) {
+                fprintf(stderr, "ERROR: -p expects height:position\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'v':
+            verify = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b height] [-p height:position] [-v] [ledger file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const char* path = optind < argc ? argv[optind] : LEDGER_FILE;
+    size_t mapped = 0;
+    Blockchain* chain = map_ledger_readonly(path, &mapped);
+    if (chain == NULL) {
+        return EXIT_FAILURE;
+    }
+    TransactionBlock* block = malloc(chain->block_size);
+    if (block == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    print_summary(chain);
+    if (show >= 0) {
+        if (ledger_read_block(chain, (uint64_t)show, block) == 0) {
+            print_block(block, (uint64_t)show, chain->transactions_per_block);
+        } else {
+            fprintf(stderr, "ERROR: block %lld is not in the ledger\n", show);
+            status = EXIT_FAILURE;
+        }
+    }
+    if (prove >= 0) {
+        if (ledger_read_block(chain, (uint64_t)prove, block) != 0) {
+            fprintf(stderr, "ERROR: block %lld is not in the ledger\n", prove);
+            status = EXIT_FAILURE;
+        } else if (print_proof(block, chain->transactions_per_block, prove_index) != 0) {
+            status = EXIT_FAILURE;
+        }
+    }
+    if (verify && verify_chain(chain, block) != 0) {
+        status = EXIT_FAILURE;
+    }
+
+    free(block);
+    archive_close();
+    munmap(chain, mapped);
+    return status;
+}
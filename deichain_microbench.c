@@ -0,0 +1,651 @@
+// deichain-microbench: microbenchmarks dos kernels que dominam o CPU, isolados do resto
+// do sistema (SHA-256, pool, lookup do validator, serialização de blocos, saldos, log_message).
+//
+//   deichain-microbench [-t max_threads] [-r repetições] [-W aquecimento] [-x tx_por_bloco] [-c] [filtro]
+//     -c      CSV em vez de tabela
+//     filtro  só corre os benchmarks cujo nome contém o texto (ex.: "pool")
+//
+// Cada thread fica fixa num CPU (thread i -> CPU i % nproc), as repetições de aquecimento
+// são descartadas e cada linha mostra a média, o desvio padrão e o mínimo de ns/op.
+// Usa /log_mutex e /log_shm: não correr ao mesmo tempo que um controller.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "common.h"
+#include "sha256.h"
+#include "pow.h"
+#include "merkle.h"
+#include "accounts.h"
+#include "tx_pool.h"
+#include "validator.h"
+#include "logging.h"
+#include "trace.h"
+
+#define MICRO_MAX_THREADS 64
+#define MICRO_POOL_SIZE 4096
+#define MICRO_LOOKUP_FILL (MICRO_POOL_SIZE / 2)
+#define MICRO_CHURN (16 * MICRO_POOL_SIZE)     // insert+remove antes das procuras falhadas
+#define MICRO_ACCOUNTS 65536   // Tabela de saldos do ACCOUNT_TABLE_SIZE por omissão, preenchida até meio
+#define MICRO_LOG_OPS 128       // Menos do que um ring do log assíncrono: mede a escrita, não as perdas
+
+typedef void (*BenchFn)(int thread, long ops, void* arg);
+typedef void (*ResetFn)(void* arg);
+
+typedef struct {
+    int max_threads;
+    int reps;
+    int warmup;
+    int csv;
+    const char* filter;
+} MicroOptions;
+
+typedef struct {
+    pthread_barrier_t* start;
+    BenchFn fn;
+    void* arg;
+    int index;
+    long ops;
+    uint64_t elapsed_ns;
+} MicroWorker;
+
+static MicroOptions options = { .max_threads = 0, .reps = 10, .warmup = 2, .csv = 0, .filter = NULL };
+static FILE* report = NULL;
+static int cpu_count = 1;
+
+static volatile uint32_t sink;   // Impede o compilador de eliminar o trabalho medido
+
+static void* worker_main(void* ptr) {
+    MicroWorker* w = ptr;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->index % cpu_count, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    pthread_barrier_wait(w->start);
+    uint64_t t0 = trace_now_ns();
+    w->fn(w->index, w->ops, w->arg);
+    w->elapsed_ns = trace_now_ns() - t0;
+    return NULL;
+}
+
+static int selected(const char* name) {
+    return options.filter == NULL || strstr(name, options.filter) != NULL;
+}
+
+// Corre `threads` workers `warmup + reps` vezes; cada repetição dá a média de ns/op das threads
+static void run_bench(const char* name, int threads, long ops, BenchFn fn, ResetFn reset, void* arg) {
+    double samples[options.reps];
+    double mops_total = 0;
+    MicroWorker workers[MICRO_MAX_THREADS];
+    pthread_t ids[MICRO_MAX_THREADS];
+    pthread_barrier_t start;
+
+    for (int rep = -options.warmup; rep < options.reps; rep++) {
+        if (reset != NULL) {
+            reset(arg);
+        }
+
+        pthread_barrier_init(&start, NULL, (unsigned)threads);
+        for (int i = 0; i < threads; i++) {
+            workers[i] = (MicroWorker){ .start = &start, .fn = fn, .arg = arg, .index = i, .ops = ops };
+            pthread_create(&ids[i], NULL, worker_main, &workers[i]);
+        }
+
+        double per_op = 0;
+        uint64_t wall = 0;
+        for (int i = 0; i < threads; i++) {
+            pthread_join(ids[i], NULL);
+            per_op += (double)workers[i].elapsed_ns / (double)ops;
+            if (workers[i].elapsed_ns > wall) {
+                wall = workers[i].elapsed_ns;
+            }
+        }
+        pthread_barrier_destroy(&start);
+
+        if (rep >= 0) {
+            samples[rep] = per_op / threads;
+            mops_total += wall > 0 ? (double)threads * (double)ops * 1e3 / (double)wall : 0;
+        }
+    }
+
+    double mean = 0, var = 0, min = samples[0];
+    for (int i = 0; i < options.reps; i++) {
+        mean += samples[i];
+        if (samples[i] < min) {
+            min = samples[i];
+        }
+    }
+    mean /= options.reps;
+    for (int i = 0; i < options.reps; i++) {
+        var += (samples[i] - mean) * (samples[i] - mean);
+    }
+    double stddev = options.reps > 1 ? sqrt(var / (options.reps - 1)) : 0;
+
+    if (options.csv) {
+        fprintf(report, "%s,%d,%.2f,%.2f,%.2f,%.3f\n", name, threads, mean, stddev, min, mops_total / options.reps);
+    } else {
+        fprintf(report, "%-34s %7d %11.2f %9.2f %6.1f%% %11.2f %10.3f\n", name, threads, mean, stddev,
+                mean > 0 ? 100.0 * stddev / mean : 0.0, min, mops_total / options.reps);
+    }
+    fflush(report);
+}
+
+// Uma linha por número de threads: 1, 2, 4, ... até max_threads
+static void run_scaling(const char* name, long ops, BenchFn fn, ResetFn reset, void* arg) {
+    if (!selected(name)) {
+        return;
+    }
+    for (int threads = 1;; threads *= 2) {
+        if (threads > options.max_threads) {
+            threads = options.max_threads;   // A última linha é sempre max_threads
+        }
+        run_bench(name, threads, ops, fn, reset, arg);
+        if (threads == options.max_threads) {
+            break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SHA-256
+// ---------------------------------------------------------------------------
+
+static void bench_sha256_scalar(int thread, long ops, void* arg) {
+    (void)thread;
+    (void)arg;
+    uint8_t block[SHA256_BLOCK_SIZE] = {0};
+    uint32_t state[8];
+    sha256_init_state(state);
+    for (long i = 0; i < ops; i++) {
+        block[0] = (uint8_t)i;
+        sha256_compress(state, block);
+    }
+    sink = state[0];
+}
+
+// ops conta blocos comprimidos, para ficar comparável com a versão escalar
+static void bench_sha256_multi(int thread, long ops, void* arg) {
+    (void)thread;
+    int lanes = *(int*)arg;
+    uint8_t data[SHA256_MAX_LANES][SHA256_BLOCK_SIZE] = {{0}};
+    const uint8_t* blocks[SHA256_MAX_LANES];
+    uint32_t states[SHA256_MAX_LANES][8];
+
+    for (int l = 0; l < lanes; l++) {
+        blocks[l] = data[l];
+        sha256_init_state(states[l]);
+    }
+    for (long i = 0; i < ops; i += lanes) {
+        data[0][0] = (uint8_t)i;
+        sha256_compress_multi(states, blocks, lanes);
+    }
+    sink = states[0][0];
+}
+
+static void run_sha256(void) {
+    Sha256Impl detected = sha256_detect_impl();
+    char name[64];
+
+    sha256_set_impl(SHA256_IMPL_SCALAR);
+    if (selected("sha256/compress/scalar")) {
+        run_bench("sha256/compress/scalar", 1, 1 << 20, bench_sha256_scalar, NULL, NULL);
+    }
+
+    const Sha256Impl simd[] = { SHA256_IMPL_SSE41, SHA256_IMPL_AVX2 };
+    for (size_t i = 0; i < sizeof(simd) / sizeof(simd[0]); i++) {
+        sha256_set_impl(simd[i]);
+        if (sha256_get_impl() != simd[i]) {
+            continue;   // CPU sem suporte
+        }
+        int lanes = sha256_impl_lanes(simd[i]);
+        snprintf(name, sizeof(name), "sha256/compress/%s", sha256_impl_name(simd[i]));
+        if (selected(name)) {
+            run_bench(name, 1, 1 << 20, bench_sha256_multi, NULL, &lanes);
+        }
+    }
+    sha256_set_impl(detected);
+}
+
+// ---------------------------------------------------------------------------
+// Transaction pool
+// ---------------------------------------------------------------------------
+
+static TransactionPool* bench_pool = NULL;
+static int bench_pool_shards = 1;
+
+// Um sender por thread, como um txgen por produtor: com vários shards cada um tem o seu
+static Transaction bench_transaction(int id, int sender) {
+    Transaction t = {
+        .id = id, .reward = id % TX_REWARD_LEVELS + 1, .sender_id = sender, .receiver_id = 2,
+        .value = 10, .timestamp = 0, .age = 0, .empty = 0,
+    };
+    return t;
+}
+
+static void reset_pool(void* arg) {
+    (void)arg;
+    tx_pool_init(bench_pool, MICRO_POOL_SIZE, bench_pool_shards, MICRO_POOL_SIZE, TX_DEFAULT_LEASE_SECONDS);
+}
+
+// Um ciclo = insert + claim de uma transação (de qualquer thread) + remove
+static void bench_pool_cycle(int thread, long ops, void* arg) {
+    (void)arg;
+    Transaction out;
+    int slot;
+
+    for (long i = 0; i < ops; i++) {
+        Transaction t = bench_transaction((thread << 24) + (int)i + 1, thread + 1);
+        tx_pool_insert(bench_pool, &t);
+        // Vazio só enquanto outro produtor está a meio de um push (ou foi desescalonado nele)
+        while (tx_pool_claim(bench_pool, thread, &out, &slot, 1) == 0) {
+            sched_yield();
+        }
+        tx_pool_remove(bench_pool, slot, thread);
+    }
+}
+
+static void reset_pool_filled(void* arg) {
+    (void)arg;
+    reset_pool(NULL);
+    for (int i = 1; i <= MICRO_LOOKUP_FILL; i++) {
+        Transaction t = bench_transaction(i, 1);
+        tx_pool_insert(bench_pool, &t);
+    }
+}
+
+// Metade das procuras acerta (ids 1..FILL), a outra metade falha
+static void bench_pool_lookup(int thread, long ops, void* arg) {
+    (void)arg;
+    uint32_t x = 0x9e3779b9u * (uint32_t)(thread + 1);
+    int found = 0;
+
+    for (long i = 0; i < ops; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        found += is_transaction_in_pool((int)(x % (2 * MICRO_LOOKUP_FILL)) + 1);
+    }
+    sink = (uint32_t)found;
+}
+
+// Pool meio cheia depois de MICRO_CHURN inserções e remoções: o índice passou por todas
+// as células, como numa pool que já corre há muito tempo
+static void reset_pool_churned(void* arg) {
+    (void)arg;
+    Transaction out;
+    int slot;
+
+    reset_pool_filled(NULL);
+    for (int i = 0; i < MICRO_CHURN; i++) {
+        Transaction t = bench_transaction(MICRO_LOOKUP_FILL + 1 + i, 1);
+        tx_pool_insert(bench_pool, &t);
+        tx_pool_claim(bench_pool, 0, &out, &slot, 1);
+        tx_pool_remove(bench_pool, slot, 0);
+    }
+}
+
+// Só ids que nunca estiveram na pool (um bloco rejeitado, uma transação já confirmada)
+static void bench_pool_lookup_miss(int thread, long ops, void* arg) {
+    (void)arg;
+    uint32_t x = 0x9e3779b9u * (uint32_t)(thread + 1);
+    int found = 0;
+
+    for (long i = 0; i < ops; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        found += is_transaction_in_pool((int)(x & 0x3fffffff) | 0x40000000);
+    }
+    sink = (uint32_t)found;
+}
+
+// Pool meio cheia com um quarto das transações reservadas: o reaper percorre a pool
+// inteira sem que nenhuma reserva expire
+static void reset_pool_leased(void* arg) {
+    (void)arg;
+    Transaction out;
+    int slot;
+
+    reset_pool_filled(NULL);
+    for (int i = 0; i < MICRO_LOOKUP_FILL / 4; i++) {
+        tx_pool_claim(bench_pool, 0, &out, &slot, 1);
+    }
+}
+
+static void bench_pool_reap(int thread, long ops, void* arg) {
+    (void)thread;
+    (void)arg;
+    int reaped = 0;
+
+    for (long i = 0; i < ops; i++) {
+        reaped += tx_pool_reap_expired(bench_pool);
+    }
+    sink = (uint32_t)reaped;
+}
+
+static void run_pool(void) {
+    int shards = tx_pool_shard_count(MICRO_POOL_SIZE, 0);
+    size_t bytes = tx_pool_size(MICRO_POOL_SIZE, 1);
+    if (tx_pool_size(MICRO_POOL_SIZE, shards) > bytes) {
+        bytes = tx_pool_size(MICRO_POOL_SIZE, shards);
+    }
+    bench_pool = malloc(bytes);
+    if (bench_pool == NULL) {
+        fprintf(stderr, "ERROR: cannot allocate the benchmark pool\n");
+        return;
+    }
+    tx_pool_ptr = bench_pool;   // is_transaction_in_pool() usa a pool global
+
+    bench_pool_shards = 1;
+    run_scaling("pool/insert+claim+remove", 1 << 16, bench_pool_cycle, reset_pool, NULL);
+    run_scaling("pool/is_transaction_in_pool", 1 << 20, bench_pool_lookup, reset_pool_filled, NULL);
+    run_scaling("pool/lookup_miss_after_churn", 1 << 20, bench_pool_lookup_miss, reset_pool_churned, NULL);
+    run_scaling("pool/reap_expired", 1 << 12, bench_pool_reap, reset_pool_leased, NULL);
+    bench_pool_shards = shards;
+    run_scaling("pool/sharded/insert+claim+remove", 1 << 16, bench_pool_cycle, reset_pool, NULL);
+
+    tx_pool_ptr = NULL;
+    free(bench_pool);
+    bench_pool = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Blocos
+// ---------------------------------------------------------------------------
+
+static TransactionBlock* bench_block = NULL;
+
+static void bench_block_serialize(int thread, long ops, void* arg) {
+    (void)thread;
+    uint8_t* header = arg;
+
+    for (long i = 0; i < ops; i++) {
+        bench_block->merkle_root[0] = (uint8_t)i;
+        pow_serialize_header(bench_block, header);
+    }
+    sink = header[0];
+}
+
+static void bench_block_hash(int thread, long ops, void* arg) {
+    (void)thread;
+    (void)arg;
+    char hex[HASH_SIZE];
+
+    for (long i = 0; i < ops; i++) {
+        bench_block->nonce = (unsigned int)i;
+        pow_block_hash(bench_block, hex);
+    }
+    sink = (uint32_t)hex[0];
+}
+
+static void bench_block_pow_verify(int thread, long ops, void* arg) {
+    (void)thread;
+    (void)arg;
+    int ok = 0;
+
+    for (long i = 0; i < ops; i++) {
+        ok += pow_verify(bench_block, 0);
+    }
+    sink = (uint32_t)ok;
+}
+
+// Como o validator verifica um lote: SHA256_MAX_LANES cabeçalhos em lockstep (ops = blocos)
+static void bench_block_pow_verify_batch(int thread, long ops, void* arg) {
+    (void)thread;
+    (void)arg;
+    const TransactionBlock* blocks[SHA256_MAX_LANES];
+    int results[SHA256_MAX_LANES];
+    int ok = 0;
+
+    for (int l = 0; l < SHA256_MAX_LANES; l++) {
+        blocks[l] = bench_block;
+    }
+    for (long i = 0; i < ops; i += SHA256_MAX_LANES) {
+        int n = ops - i < SHA256_MAX_LANES ? (int)(ops - i) : SHA256_MAX_LANES;
+        pow_verify_batch(blocks, n, 0, results);
+        ok += results[0];
+    }
+    sink = (uint32_t)ok;
+}
+
+static void bench_block_merkle_root(int thread, long ops, void* arg) {
+    (void)thread;
+    (void)arg;
+    int n_tx = global_config.transactions_per_block;
+
+    for (long i = 0; i < ops; i++) {
+        bench_block->transactions[0].value = (int)i;
+        merkle_root(bench_block->transactions, n_tx, bench_block->merkle_root);
+    }
+    sink = bench_block->merkle_root[0];
+}
+
+// Verificar uma transação com a prova: O(log n) hashes, sem tocar no resto do bloco
+static void bench_block_merkle_verify(int thread, long ops, void* arg) {
+    (void)thread;
+    MerkleProof* proof = arg;
+    int ok = 0;
+
+    for (long i = 0; i < ops; i++) {
+        ok += merkle_verify(&bench_block->transactions[proof->index], proof, bench_block->merkle_root);
+    }
+    sink = (uint32_t)ok;
+}
+
+static void run_block(void) {
+    int n_tx = global_config.transactions_per_block;
+    bench_block = calloc(1, get_transaction_block_size());
+    uint8_t* header = malloc(pow_header_len());
+    if (bench_block == NULL || header == NULL) {
+        fprintf(stderr, "ERROR: cannot allocate the benchmark block\n");
+        free(bench_block);
+        free(header);
+        return;
+    }
+
+    snprintf(bench_block->txb_id, TXB_ID_LEN, "%d-0-0", getpid());
+    memset(bench_block->previous_block_hash, '0', HASH_SIZE - 1);
+    bench_block->timestamp = time(NULL);
+    for (int i = 0; i < n_tx; i++) {
+        bench_block->transactions[i] = bench_transaction(i + 1, 1);
+        bench_block->transactions[i].timestamp = trace_now_ns();
+    }
+
+    if (selected("block/serialize_header")) {
+        run_bench("block/serialize_header", 1, 1 << 18, bench_block_serialize, NULL, header);
+    }
+    if (selected("block/hash")) {
+        run_bench("block/hash", 1, 1 << 16, bench_block_hash, NULL, NULL);
+    }
+    if (selected("block/pow_verify")) {
+        run_bench("block/pow_verify", 1, 1 << 16, bench_block_pow_verify, NULL, NULL);
+    }
+    if (selected("block/pow_verify_batch")) {
+        run_bench("block/pow_verify_batch", 1, 1 << 16, bench_block_pow_verify_batch, NULL, NULL);
+    }
+    if (selected("block/merkle_root")) {
+        run_bench("block/merkle_root", 1, 1 << 14, bench_block_merkle_root, NULL, NULL);
+    }
+    if (selected("block/merkle_verify")) {
+        MerkleProof proof;
+        merkle_root(bench_block->transactions, n_tx, bench_block->merkle_root);
+        merkle_proof(bench_block->transactions, n_tx, n_tx / 2, &proof);
+        run_bench("block/merkle_verify", 1, 1 << 16, bench_block_merkle_verify, NULL, &proof);
+    }
+
+    free(header);
+    free(bench_block);
+    bench_block = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Saldos
+// ---------------------------------------------------------------------------
+
+static AccountTable* bench_accounts = NULL;
+
+static void bench_account_balance(int thread, long ops, void* arg) {
+    (void)arg;
+    uint64_t x = (uint64_t)thread * 0x9e3779b97f4a7c15ull + 1;
+    int64_t total = 0;
+    for (long i = 0; i < ops; i++) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        int64_t balance;
+        account_balance(bench_accounts, (int)(x >> 33) % MICRO_ACCOUNTS + 1, &balance);
+        total += balance;
+    }
+    sink = (uint32_t)total;
+}
+
+// Uma operação = aplicar um bloco (remetente e destinatário por transação) e desfazê-lo,
+// o custo de um bloco rejeitado depois de chegar aos saldos
+static void bench_account_apply_rollback(int thread, long ops, void* arg) {
+    (void)thread;
+    AccountBatch* batch = arg;
+    int n_tx = global_config.transactions_per_block;
+    int applied = 0;
+
+    for (long i = 0; i < ops; i++) {
+        bench_block->transactions[0].value = (int)(i & 63);
+        applied += account_apply_block(bench_accounts, bench_block, n_tx, batch) == 0;
+        account_rollback(bench_accounts, batch);
+    }
+    sink = (uint32_t)applied;
+}
+
+static void run_accounts(void) {
+    int n_tx = global_config.transactions_per_block;
+    AccountBatch batch;
+    bench_accounts = malloc(account_table_size(MICRO_ACCOUNTS));
+    bench_block = calloc(1, get_transaction_block_size());
+    if (bench_accounts == NULL || bench_block == NULL || account_batch_init(&batch, n_tx) != 0) {
+        fprintf(stderr, "ERROR: cannot allocate the benchmark account table\n");
+        free(bench_accounts);
+        free(bench_block);
+        return;
+    }
+    account_table_init(bench_accounts, MICRO_ACCOUNTS, ACCOUNT_DEFAULT_INITIAL_BALANCE);
+
+    // Metade das contas já existe; os blocos medidos misturam contas novas e conhecidas
+    for (int base = 1; base <= MICRO_ACCOUNTS / 2; base += n_tx) {
+        for (int i = 0; i < n_tx; i++) {
+            bench_block->transactions[i] = bench_transaction(base + i, base + i);
+            bench_block->transactions[i].receiver_id = (base + i) % (MICRO_ACCOUNTS / 2) + 1;
+        }
+        account_apply_block(bench_accounts, bench_block, n_tx, &batch);
+        account_commit(bench_accounts, &batch);
+    }
+    for (int i = 0; i < n_tx; i++) {
+        bench_block->transactions[i] = bench_transaction(i + 1, i * 7919 % MICRO_ACCOUNTS + 1);
+        bench_block->transactions[i].receiver_id = i * 104729 % MICRO_ACCOUNTS + 1;
+    }
+
+    run_scaling("accounts/balance", 1 << 20, bench_account_balance, NULL, NULL);
+    if (selected("accounts/apply+rollback")) {
+        run_bench("accounts/apply+rollback", 1, 1 << 16, bench_account_apply_rollback, NULL, &batch);
+    }
+
+    account_batch_free(&batch);
+    free(bench_block);
+    free(bench_accounts);
+    bench_block = NULL;
+    bench_accounts = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// log_message
+// ---------------------------------------------------------------------------
+
+static void bench_log_message(int thread, long ops, void* arg) {
+    (void)arg;
+    for (long i = 0; i < ops; i++) {
+        log_message("MINER: Team of miner %d found nonce %ld for block %d-%d-%ld",
+                    thread, i * 7919, getpid(), thread, i);
+    }
+}
+
+// Dá ao flusher tempo para esvaziar os rings entre repetições
+static void reset_log_async(void* arg) {
+    (void)arg;
+    struct timespec ts = { 0, 80 * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void run_log(void) {
+    run_scaling("log_message/sync", MICRO_LOG_OPS, bench_log_message, NULL, NULL);
+
+    if (selected("log_message/async") && log_create_async() == 0 && log_start_flusher() == 0) {
+        run_scaling("log_message/async", MICRO_LOG_OPS, bench_log_message, reset_log_async, NULL);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+
+    global_config.transactions_per_block = 10;
+    while ((opt = getopt(argc, argv, "t:r:W:x:c")) != -1) {
+        switch (opt) {
+        case 't': options.max_threads = atoi(optarg); break;
+        case 'r': options.reps = atoi(optarg); break;
+        case 'W': options.warmup = atoi(optarg); break;
+        case 'x': global_config.transactions_per_block = atoi(optarg); break;
+        case 'c': options.csv = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-t max_threads] [-r reps] [-W warmup] [-x tx_per_block] [-c] [filter]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    options.filter = optind < argc ? argv[optind] : NULL;
+
+    cpu_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count < 1) {
+        cpu_count = 1;
+    }
+    if (options.max_threads <= 0) {
+        options.max_threads = cpu_count;
+    }
+    if (options.max_threads > MICRO_MAX_THREADS || options.reps < 1 || options.warmup < 0 ||
+        global_config.transactions_per_block < 1) {
+        fprintf(stderr, "ERROR: invalid options\n");
+        return EXIT_FAILURE;
+    }
+    transactions_per_block = (size_t)global_config.transactions_per_block;
+
+    // O eco do log na consola iria parar ao meio da tabela: o stdout passa para /dev/null
+    fflush(stdout);
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    int devnull = open("/dev/null", O_WRONLY);
+    if (report == NULL || devnull == -1 || dup2(devnull, STDOUT_FILENO) == -1) {
+        fprintf(stderr, "ERROR: cannot redirect stdout\n");
+        return EXIT_FAILURE;
+    }
+    close(devnull);
+    log_init("/dev/null");
+
+    if (options.csv) {
+        fprintf(report, "benchmark,threads,ns_per_op,stddev,min,mops_per_s\n");
+    } else {
+        fprintf(report, "SHA-256 kernel: %s, %d CPU(s), %d reps after %d warmup\n",
+                sha256_impl_name(sha256_detect_impl()), cpu_count, options.reps, options.warmup);
+        fprintf(report, "%-34s %7s %11s %9s %7s %11s %10s\n", "benchmark", "threads", "ns/op", "stddev",
+                "cv", "min ns/op", "Mops/s");
+    }
+
+    run_sha256();
+    run_pool();
+    run_block();
+    run_accounts();
+    run_log();
+
+    log_close();
+    fclose(report);
+    return EXIT_SUCCESS;
+}
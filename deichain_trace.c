@@ -0,0 +1,151 @@
+// deichain-trace: converte o trace binário (DEIChain_trace.bin) em texto ou CSV e
+// calcula a taxa de cada evento.
+//
+//   deichain-trace [-c] [-r] [ficheiro]
+//     -c  CSV em vez de texto
+//     -r  apenas o resumo de taxas por evento
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+
+static int compare_records(const void* a, const void* b) {
+    const TraceRecord* ra = a;
+    const TraceRecord* rb = b;
+    return (ra->ts_ns > rb->ts_ns) - (ra->ts_ns < rb->ts_ns);
+}
+
+static TraceRecord* load_trace(const char* path, size_t* count) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "ERROR: cannot open %s\n", path);
+        return NULL;
+    }
+
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "ERROR: %s is not a DEIChain trace\n", path);
+        fclose(file);
+        return NULL;
+    }
+    if (header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "ERROR: unsupported trace version %u (record size %u)\n",
+                header.version, header.record_size);
+        fclose(file);
+        return NULL;
+    }
+
+    size_t capacity = 4096;
+    TraceRecord* records = malloc(capacity * sizeof(TraceRecord));
+    *count = 0;
+    while (records != NULL && fread(&records[*count], sizeof(TraceRecord), 1, file) == 1) {
+        if (++*count == capacity) {
+            capacity *= 2;
+            TraceRecord* grown = realloc(records, capacity * sizeof(TraceRecord));
+            if (grown == NULL) {
+                free(records);
+                records = NULL;
+                break;
+            }
+            records = grown;
+        }
+    }
+    fclose(file);
+
+    if (records == NULL) {
+        fprintf(stderr, "ERROR: out of memory reading %s\n", path);
+        return NULL;
+    }
+
+    // Cada thread escreve o seu buffer de uma vez: o ficheiro só está ordenado por blocos
+    qsort(records, *count, sizeof(TraceRecord), compare_records);
+    return records;
+}
+
+static void print_records(const TraceRecord* records, size_t count, int csv) {
+    uint64_t t0 = count > 0 ? records[0].ts_ns : 0;
+
+    if (csv) {
+        printf("time_s,event,pid,tid,miner_id,tx_id,slot,block_seq,nonce,aux\n");
+    }
+    for (size_t i = 0; i < count; i++) {
+        const TraceRecord* r = &records[i];
+        double t = (double)(r->ts_ns - t0) / 1e9;
+        if (csv) {
+            printf("%.9f,%s,%u,%u,%d,%d,%d,%u,%u,%d\n", t, trace_event_name(r->event),
+                   r->pid, r->tid, r->miner_id, r->tx_id, r->slot, r->block_seq, r->nonce, r->aux);
+        } else {
+            printf("+%12.6f  %-13s pid=%u tid=%u miner=%d tx=%d slot=%d block=%u nonce=%u aux=%d\n",
+                   t, trace_event_name(r->event), r->pid, r->tid, r->miner_id, r->tx_id,
+                   r->slot, r->block_seq, r->nonce, r->aux);
+        }
+    }
+}
+
+static void print_rates(const TraceRecord* records, size_t count) {
+    uint64_t counts[TRACE_EVENT_COUNT] = {0};
+    uint64_t first[TRACE_EVENT_COUNT] = {0};
+    uint64_t last[TRACE_EVENT_COUNT] = {0};
+
+    for (size_t i = 0; i < count; i++) {
+        int e = records[i].event;
+        if (e <= 0 || e >= TRACE_EVENT_COUNT) {
+            continue;
+        }
+        if (counts[e]++ == 0) {
+            first[e] = records[i].ts_ns;
+        }
+        last[e] = records[i].ts_ns;
+    }
+
+    double span = count > 1 ? (double)(records[count - 1].ts_ns - records[0].ts_ns) / 1e9 : 0.0;
+    printf("Trace: %zu records over %.3f s\n", count, span);
+    printf("%-14s %10s %12s %14s\n", "event", "count", "events/s", "active span s");
+    for (int e = 1; e < TRACE_EVENT_COUNT; e++) {
+        if (counts[e] == 0) {
+            continue;
+        }
+        double active = (double)(last[e] - first[e]) / 1e9;
+        printf("%-14s %10llu %12.2f %14.3f\n", trace_event_name(e), (unsigned long long)counts[e],
+               span > 0 ? (double)counts[e] / span : 0.0, active);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int csv = 0;
+    int rates_only = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "cr")) != -1) {
+        switch (opt) {
+        case 'c':
+            csv = 1;
+            break;
+        case 'r':
+            rates_only = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-c] [-r] [trace file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const char* path = optind < argc ? argv[optind] : TRACE_FILE;
+    size_t count = 0;
+    TraceRecord* records = load_trace(path, &count);
+    if (records == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    if (!rates_only) {
+        print_records(records, count, csv);
+    }
+    if (rates_only || !csv) {
+        print_rates(records, count);
+    }
+
+    free(records);
+    return EXIT_SUCCESS;
+}
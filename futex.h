@@ -0,0 +1,35 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Process-shared futex helpers: the word must live in a MAP_SHARED mapping, so the
+// private flag is never used. futex_wait returns when *addr != expected, on a wake-up,
+// on a signal or after timeout_ms (< 0 waits forever).
+static inline void futex_wait(_Atomic uint32_t* addr, uint32_t expected, int timeout_ms) {
+    struct timespec ts;
+    struct timespec* tsp = NULL;
+
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        tsp = &ts;
+    }
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, expected, tsp, NULL, 0);
+}
+
+static inline void futex_wake(_Atomic uint32_t* addr, int waiters) {
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, waiters, NULL, NULL, 0);
+}
+
+static inline void futex_wake_all(_Atomic uint32_t* addr) {
+    futex_wake(addr, INT_MAX);
+}
+
+#endif
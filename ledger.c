@@ -0,0 +1,505 @@
+#include "ledger.h"
+#include "archive.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// crc32c_hw usa o crc32 de 64 bits, que só existe em x86-64
+#if defined(__x86_64__)
+#define LEDGER_HAVE_SSE42 1
+#endif
+
+// Estado do mapeamento neste processo (o validator é o único que acrescenta registos)
+static Blockchain* ledger_chain = NULL;
+static int ledger_fd = -1;
+static size_t ledger_mapped = 0;       // Bytes mapeados: cabeçalho + capacity registos
+static off_t ledger_file_size = 0;     // Tamanho atual do ficheiro (cresce por extents)
+static int ledger_grown = 0;           // O ficheiro cresceu desde o último sync: fdatasync
+static int ledger_group_commit = LEDGER_DEFAULT_GROUP_COMMIT;
+static uint64_t ledger_first_pending_ns = 0;
+
+// ---------------------------------------------------------------------------
+// CRC32C (Castagnoli)
+// ---------------------------------------------------------------------------
+
+static uint32_t crc32c_table[256];
+static int crc32c_table_ready = 0;
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t* p, size_t len) {
+    if (!crc32c_table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c >> 1) ^ (0x82f63b78u & (0u - (c & 1)));
+            }
+            crc32c_table[i] = c;
+        }
+        crc32c_table_ready = 1;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+#ifdef LEDGER_HAVE_SSE42
+// Instrução crc32 do SSE4.2: 8 bytes por instrução
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, size_t len) {
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __builtin_ia32_crc32di(c, v);
+        p += 8;
+        len -= 8;
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (len--) {
+        c32 = __builtin_ia32_crc32qi(c32, *p++);
+    }
+    return c32;
+}
+#endif
+
+// Sem inversões: quem calcula um checksum começa em ~0 e inverte o resultado
+uint32_t ledger_crc32c(uint32_t crc, const void* data, size_t len) {
+#ifdef LEDGER_HAVE_SSE42
+    static int hw = -1;
+    if (hw < 0) {
+        __builtin_cpu_init();
+        hw = __builtin_cpu_supports("sse4.2") != 0;
+    }
+    if (hw) {
+        return crc32c_hw(crc, data, len);
+    }
+#endif
+    return crc32c_sw(crc, data, len);
+}
+
+// ---------------------------------------------------------------------------
+// Registos
+// ---------------------------------------------------------------------------
+
+static inline LedgerRecordTrailer* record_trailer(Blockchain* chain, uint64_t height) {
+    return (LedgerRecordTrailer*)((char*)blockchain_block_at(chain, height) + chain->record_size -
+                                  sizeof(LedgerRecordTrailer));
+}
+
+static uint32_t block_checksum(const void* block, size_t block_size, uint64_t height) {
+    uint32_t crc = ledger_crc32c(~0u, block, block_size);
+    return ~ledger_crc32c(crc, &height, sizeof(height));
+}
+
+static uint32_t record_checksum(Blockchain* chain, uint64_t height) {
+    return block_checksum(blockchain_block_at(chain, height), chain->block_size, height);
+}
+
+// A altura no trailer distingue o registo pedido do de uma volta anterior do anel
+static int record_valid(Blockchain* chain, uint64_t height) {
+    LedgerRecordTrailer* trailer = record_trailer(chain, height);
+    return trailer->magic == LEDGER_RECORD_MAGIC && trailer->height == height &&
+           trailer->checksum == record_checksum(chain, height);
+}
+
+// Slots do anel ocupados por uma cadeia com `count` blocos
+static inline uint64_t slots_used(const Blockchain* chain, uint64_t count) {
+    return count < (uint64_t)chain->capacity ? count : (uint64_t)chain->capacity;
+}
+
+static inline off_t slot_end(const Blockchain* chain, uint64_t slots) {
+    return (off_t)(sizeof(Blockchain) + slots * chain->record_size);
+}
+
+static uint32_t footer_checksum(const LedgerFooter* footer) {
+    return ~ledger_crc32c(~0u, footer, offsetof(LedgerFooter, checksum));
+}
+
+static uint64_t ledger_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Enquanto o anel não deu a primeira volta, o ficheiro acompanha os registos escritos
+// com folga de um extent; o mapeamento cobre logo a janela toda, e só as páginas
+// dentro do ficheiro são tocadas
+static int ensure_file_size(Blockchain* chain, uint64_t count) {
+    off_t needed = slot_end(chain, slots_used(chain, count));
+    if (needed <= ledger_file_size) {
+        return 0;
+    }
+    off_t target = slot_end(chain, slots_used(chain, count + LEDGER_EXTENT_RECORDS - 1));
+    if (ftruncate(ledger_fd, target) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to extend %s: %s", LEDGER_FILE, strerror(errno));
+        return -1;
+    }
+    ledger_file_size = target;
+    ledger_grown = 1;
+    return 0;
+}
+
+static Blockchain* map_ledger(size_t size) {
+    Blockchain* chain = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ledger_fd, 0);
+    if (chain == MAP_FAILED) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: mmap failed for %s: %s", LEDGER_FILE, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    ledger_mapped = size;
+    return chain;
+}
+
+// Blocos por segmento do arquivo: no máximo metade da janela, para o arquivo inline
+// em ledger_append encontrar sempre um segmento completo e sincronizado
+static int segment_blocks_for(int capacity) {
+    int blocks = capacity / 2 < ARCHIVE_SEGMENT_BLOCKS ? capacity / 2 : ARCHIVE_SEGMENT_BLOCKS;
+    return blocks > 0 ? blocks : 1;
+}
+
+static int header_matches(const Blockchain* header, const Config* config) {
+    if (memcmp(header->magic, LEDGER_MAGIC, sizeof(header->magic)) != 0 || header->version != LEDGER_VERSION) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: %s is not a DEIChain ledger (version %u)", LEDGER_FILE, header->version);
+        return 0;
+    }
+    if (header->transactions_per_block != config->transactions_per_block ||
+        header->record_size != get_ledger_record_size()) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: %s was written with %d transactions per block, configuration has %d",
+                  LEDGER_FILE, header->transactions_per_block, config->transactions_per_block);
+        return 0;
+    }
+    // A posição de cada altura no anel depende do tamanho da janela
+    if (header->capacity != config->blockchain_blocks ||
+        header->segment_blocks != segment_blocks_for(header->capacity)) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: %s was written with a window of %d blocks, BLOCKCHAIN_BLOCKS is %d",
+                  LEDGER_FILE, header->capacity, config->blockchain_blocks);
+        return 0;
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Abertura e recuperação
+// ---------------------------------------------------------------------------
+
+static Blockchain* create_ledger(const Config* config) {
+    if (ftruncate(ledger_fd, sizeof(Blockchain)) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to size %s: %s", LEDGER_FILE, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    Blockchain* chain = map_ledger(get_blockchain_size(config->blockchain_blocks));
+    memset(chain, 0, sizeof(Blockchain));
+    memcpy(chain->magic, LEDGER_MAGIC, sizeof(chain->magic));
+    chain->version = LEDGER_VERSION;
+    chain->transactions_per_block = config->transactions_per_block;
+    chain->capacity = config->blockchain_blocks;
+    chain->segment_blocks = segment_blocks_for(chain->capacity);
+    chain->block_count = 0;
+    chain->block_size = get_transaction_block_size();
+    chain->record_size = get_ledger_record_size();
+    atomic_store(&chain->synced_count, 0);
+    atomic_store(&chain->archived_count, 0);
+
+    ledger_file_size = sizeof(Blockchain);
+    if (ensure_file_size(chain, 1) == -1 || msync(chain, sizeof(Blockchain), MS_SYNC) == -1 ||
+        fdatasync(ledger_fd) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to initialize %s", LEDGER_FILE);
+        exit(EXIT_FAILURE);
+    }
+    ledger_grown = 0;
+    LOG_INFO(LOG_CAT_LEDGER, "LEDGER: %s created (window of %d blocks of %zu bytes)", LEDGER_FILE, chain->capacity,
+             chain->record_size);
+    return chain;
+}
+
+// Shutdown limpo: footer válido logo a seguir ao último slot usado, e o registo da
+// ponta íntegro
+static int read_footer(Blockchain* chain, off_t file_size, uint64_t* count) {
+    LedgerFooter footer;
+    if (file_size < slot_end(chain, 0) + (off_t)sizeof(footer) ||
+        pread(ledger_fd, &footer, sizeof(footer), file_size - (off_t)sizeof(footer)) != (ssize_t)sizeof(footer) ||
+        memcmp(footer.magic, LEDGER_FOOTER_MAGIC, sizeof(footer.magic)) != 0 ||
+        footer.checksum != footer_checksum(&footer) || footer.record_size != chain->record_size ||
+        slot_end(chain, slots_used(chain, footer.block_count)) != file_size - (off_t)sizeof(footer)) {
+        return 0;
+    }
+    if (footer.block_count < atomic_load(&chain->synced_count)) {
+        return 0;
+    }
+    if (footer.block_count > 0 &&
+        (!record_valid(chain, footer.block_count - 1) ||
+         record_trailer(chain, footer.block_count - 1)->checksum != footer.tip_checksum)) {
+        return 0;
+    }
+    *count = footer.block_count;
+    return 1;
+}
+
+// max_tx_id vai para disco com o cabeçalho, depois dos registos (ledger_sync)
+static void note_tx_ids(Blockchain* chain, const TransactionBlock* block) {
+    for (int i = 0; i < chain->transactions_per_block; i++) {
+        if (block->transactions[i].id > chain->max_tx_id) {
+            chain->max_tx_id = block->transactions[i].id;
+        }
+    }
+}
+
+static Blockchain* recover_ledger(const Config* config, off_t file_size) {
+    Blockchain header;
+    if (file_size < (off_t)sizeof(Blockchain) ||
+        pread(ledger_fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || !header_matches(&header, config)) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Cannot recover %s; move it away to start a new chain", LEDGER_FILE);
+        exit(EXIT_FAILURE);
+    }
+
+    Blockchain* chain = map_ledger(get_blockchain_size(config->blockchain_blocks));
+    uint64_t window = (uint64_t)chain->capacity;
+    uint64_t synced = atomic_load(&chain->synced_count);
+    uint64_t archived = atomic_load(&chain->archived_count);
+    uint64_t in_file = (uint64_t)(file_size - (off_t)sizeof(Blockchain)) / chain->record_size;
+    if (archived > synced || archived % (uint64_t)chain->segment_blocks != 0 || synced - archived > window ||
+        slots_used(chain, synced) > in_file) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: %s header is inconsistent (synced %llu, archived %llu, %llu slots in file)",
+                  LEDGER_FILE, (unsigned long long)synced, (unsigned long long)archived,
+                  (unsigned long long)in_file);
+        exit(EXIT_FAILURE);
+    }
+    ledger_file_size = file_size;
+
+    uint64_t count = 0;
+    uint64_t checked = 0;
+    int clean = read_footer(chain, file_size, &count);
+    if (!clean) {
+        // Crash: tudo até synced_count já estava em disco; valida só os registos seguintes,
+        // até ao primeiro rasgado, por escrever ou de uma volta anterior do anel. Nunca
+        // mais de uma janela à frente do arquivo: esses slots ainda não podiam ser reutilizados
+        count = synced;
+        while (count < archived + window && count % window < in_file && record_valid(chain, count)) {
+            note_tx_ids(chain, blockchain_block_at(chain, count));   // Cabeçalho não sincronizado
+            count++;
+            checked++;
+        }
+        if (count < archived + window && count % window < in_file) {
+            checked++;   // O registo que falhou
+        }
+    }
+
+    // Corta o footer e, antes da primeira volta, a cauda rasgada; depois disso os slots
+    // seguintes guardam registos antigos, que a altura no trailer já exclui
+    off_t valid_end = slot_end(chain, slots_used(chain, count));
+    if (ftruncate(ledger_fd, valid_end) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to truncate %s: %s", LEDGER_FILE, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    ledger_file_size = valid_end;
+    chain->block_count = count;
+    atomic_store(&chain->synced_count, count);
+    if (ensure_file_size(chain, count + 1) == -1 || msync(chain, sizeof(Blockchain), MS_SYNC) == -1 ||
+        fdatasync(ledger_fd) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to sync %s after recovery", LEDGER_FILE);
+        exit(EXIT_FAILURE);
+    }
+    ledger_grown = 0;
+
+    if (clean) {
+        LOG_INFO(LOG_CAT_LEDGER, "LEDGER: %s reopened at height %llu (clean shutdown)", LEDGER_FILE,
+                 (unsigned long long)count);
+    } else {
+        LOG_INFO(LOG_CAT_LEDGER, "LEDGER: %s recovered at height %llu after a crash (%llu tail records "
+                 "checked, %lld bytes truncated)", LEDGER_FILE, (unsigned long long)count,
+                 (unsigned long long)checked, (long long)(file_size - valid_end));
+    }
+    return chain;
+}
+
+Blockchain* ledger_open(const char* path, const Config* config) {
+    ledger_fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (ledger_fd == -1 || fstat(ledger_fd, &st) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to open %s: %s", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    ledger_group_commit = config->ledger_group_commit;
+
+    ledger_chain = st.st_size == 0 ? create_ledger(config) : recover_ledger(config, st.st_size);
+    archive_open(ledger_chain);
+    return ledger_chain;
+}
+
+Blockchain* ledger_attach(const char* path, const Config* config) {
+    ledger_group_commit = config->ledger_group_commit;
+    ledger_first_pending_ns = 0;
+    if (ledger_chain != NULL) {
+        return ledger_chain;   // Filho de um fork do controller: o mapeamento e os descritores são herdados
+    }
+
+    ledger_fd = open(path, O_RDWR);
+    struct stat st;
+    if (ledger_fd == -1 || fstat(ledger_fd, &st) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to open %s: %s", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    ledger_file_size = st.st_size;
+    ledger_grown = 0;
+
+    ledger_chain = map_ledger(get_blockchain_size(config->blockchain_blocks));
+    LOG_INFO(LOG_CAT_SHM, "SHM: ledger %s mapped (height %llu, window of %d blocks)", path,
+             (unsigned long long)ledger_chain->block_count, ledger_chain->capacity);
+    return ledger_chain;
+}
+
+// ---------------------------------------------------------------------------
+// Escrita
+// ---------------------------------------------------------------------------
+
+int ledger_append(Blockchain* chain, const TransactionBlock* block) {
+    uint64_t height = chain->block_count;
+    if (ensure_file_size(chain, height + 1) == -1) {
+        return -1;
+    }
+    // O slot só é reutilizado depois de o bloco que lá está ir para o arquivo; se a thread
+    // de arquivo ficou uma janela inteira para trás, arquiva aqui
+    while (height - atomic_load(&chain->archived_count) >= (uint64_t)chain->capacity) {
+        if (ledger_sync(chain) == -1 || archive_segment(chain) == -1) {
+            return -1;
+        }
+    }
+
+    note_tx_ids(chain, block);
+    memcpy(blockchain_block_at(chain, height), block, chain->block_size);
+    LedgerRecordTrailer* trailer = record_trailer(chain, height);
+    trailer->height = height;
+    trailer->checksum = record_checksum(chain, height);
+    trailer->magic = LEDGER_RECORD_MAGIC;
+    chain->block_count = height + 1;
+
+    if (ledger_first_pending_ns == 0) {
+        ledger_first_pending_ns = ledger_now_ns();
+    }
+    if (chain->block_count - atomic_load(&chain->synced_count) >= (uint64_t)ledger_group_commit) {
+        return ledger_sync(chain);
+    }
+    return 0;
+}
+
+int ledger_has_pending(const Blockchain* chain) {
+    return chain->block_count > atomic_load(&chain->synced_count);
+}
+
+// msync de `slots` slots consecutivos do anel a partir de `first`, alinhado à página
+static int sync_slots(Blockchain* chain, uint64_t first, uint64_t slots) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = (size_t)slot_end(chain, first) & ~(page - 1);
+    size_t end = (size_t)slot_end(chain, first + slots);
+    return msync((char*)chain + start, end - start, MS_SYNC);
+}
+
+// Group commit: um msync para os registos novos (dois se o anel deu a volta), fdatasync
+// só se o ficheiro cresceu (metadados), e por fim synced_count no cabeçalho
+int ledger_sync(Blockchain* chain) {
+    uint64_t count = chain->block_count;
+    uint64_t synced = atomic_load(&chain->synced_count);
+    if (count <= synced) {
+        return 0;
+    }
+
+    uint64_t window = (uint64_t)chain->capacity;
+    uint64_t pending = count - synced < window ? count - synced : window;
+    uint64_t first = (count - pending) % window;
+    uint64_t head = first + pending <= window ? pending : window - first;
+    if (sync_slots(chain, first, head) == -1 || (head < pending && sync_slots(chain, 0, pending - head) == -1) ||
+        (ledger_grown && fdatasync(ledger_fd) == -1)) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to sync %s: %s", LEDGER_FILE, strerror(errno));
+        return -1;
+    }
+    ledger_grown = 0;
+
+    atomic_store(&chain->synced_count, count);
+    if (msync(chain, sizeof(Blockchain), MS_SYNC) == -1) {
+        LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to sync the %s header: %s", LEDGER_FILE, strerror(errno));
+        return -1;
+    }
+    ledger_first_pending_ns = 0;
+    archive_notify();
+    LOG_DEBUG(LOG_CAT_LEDGER, "LEDGER: group commit up to height %llu", (unsigned long long)count - 1);
+    return 0;
+}
+
+int ledger_sync_if_due(Blockchain* chain) {
+    if (!ledger_has_pending(chain)) {
+        return 0;
+    }
+    if (ledger_first_pending_ns == 0) {
+        ledger_first_pending_ns = ledger_now_ns();   // Registos herdados de outro processo
+    }
+    if (ledger_now_ns() - ledger_first_pending_ns >= LEDGER_SYNC_INTERVAL_MS * 1000000ull) {
+        return ledger_sync(chain);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Leitura
+// ---------------------------------------------------------------------------
+
+int ledger_read_block(Blockchain* chain, uint64_t height, TransactionBlock* out) {
+    uint64_t count = chain->block_count;
+    if (height >= count) {
+        return -1;
+    }
+    if (count - height <= (uint64_t)chain->capacity) {
+        // Copia e só depois confere o trailer: se o validator reutilizou o slot entretanto,
+        // a altura ou o checksum já não batem e o bloco está no arquivo
+        const char* record = (const char*)blockchain_block_at(chain, height);
+        LedgerRecordTrailer trailer;
+        memcpy(out, record, chain->block_size);
+        memcpy(&trailer, record + chain->record_size - sizeof(trailer), sizeof(trailer));
+        if (trailer.magic == LEDGER_RECORD_MAGIC && trailer.height == height &&
+            trailer.checksum == block_checksum(out, chain->block_size, height)) {
+            return 0;
+        }
+    }
+    return archive_read_block(chain, height, out);
+}
+
+void ledger_close(Blockchain* chain, int seal) {
+    if (chain == NULL) {
+        return;
+    }
+    archive_close();
+    ledger_sync(chain);
+
+    if (seal) {
+        // Sem extents por usar: o footer fica logo a seguir ao último slot usado
+        uint64_t count = chain->block_count;
+        LedgerFooter footer;
+        memset(&footer, 0, sizeof(footer));
+        memcpy(footer.magic, LEDGER_FOOTER_MAGIC, sizeof(footer.magic));
+        footer.block_count = count;
+        footer.record_size = chain->record_size;
+        footer.tip_checksum = count > 0 ? record_trailer(chain, count - 1)->checksum : 0;
+        footer.checksum = footer_checksum(&footer);
+
+        off_t end = slot_end(chain, slots_used(chain, count));
+        if (ftruncate(ledger_fd, end) == -1 ||
+            pwrite(ledger_fd, &footer, sizeof(footer), end) != (ssize_t)sizeof(footer) || fdatasync(ledger_fd) == -1) {
+            LOG_ERROR(LOG_CAT_LEDGER, "ERROR: Failed to write the %s footer: %s", LEDGER_FILE, strerror(errno));
+        } else {
+            LOG_INFO(LOG_CAT_LEDGER, "LEDGER: %s sealed at height %llu (%llu blocks archived)", LEDGER_FILE,
+                     (unsigned long long)count, (unsigned long long)atomic_load(&chain->archived_count));
+        }
+    }
+
+    munmap(chain, ledger_mapped);
+    close(ledger_fd);
+    ledger_chain = NULL;
+    ledger_fd = -1;
+    ledger_mapped = 0;
+}
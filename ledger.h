@@ -0,0 +1,58 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <stdint.h>
+#include "common.h"
+
+#define LEDGER_FILE "DEIChain_ledger.dat"
+#define LEDGER_MAGIC "DEILEDG1"
+#define LEDGER_FOOTER_MAGIC "DEIFOOT1"
+#define LEDGER_RECORD_MAGIC 0x4b4c4244u     // "DBLK"
+#define LEDGER_VERSION 3                   // 2: janela em anel + arquivo; 3: raiz de Merkle no bloco
+#define LEDGER_DEFAULT_GROUP_COMMIT 32     // Blocos por sync
+#define LEDGER_SYNC_INTERVAL_MS 100        // Um grupo incompleto nunca espera mais do que isto
+#define LEDGER_EXTENT_RECORDS 256          // O ficheiro cresce este número de registos de cada vez
+
+// Fim de cada registo (últimos bytes do passo record_size), escrito depois do bloco.
+// Um registo rasgado ou por escrever falha o magic, a altura ou o checksum.
+typedef struct {
+    uint64_t height;
+    uint32_t checksum;    // CRC32C do bloco seguido da altura
+    uint32_t magic;       // LEDGER_RECORD_MAGIC
+} LedgerRecordTrailer;
+
+// Footer written after the last used slot on a clean shutdown. The height -> slot
+// mapping is implicit (fixed-size records, height % capacity), so the footer only has
+// to vouch for the chain height; its presence lets the next start skip the tail scan.
+typedef struct {
+    char magic[8];        // LEDGER_FOOTER_MAGIC
+    uint64_t block_count;
+    uint64_t record_size;
+    uint32_t tip_checksum;   // Checksum do último registo
+    uint32_t checksum;       // CRC32C dos campos anteriores
+} LedgerFooter;
+
+// Ledger: the Blockchain header, a ring of `capacity` fixed-size block records (the hot
+// window of the most recent blocks) and, after a clean shutdown, a footer, all in one
+// memory-mapped file. The chain is used straight from the mapping, so a restart remaps
+// the file in place instead of replaying it. Older blocks live in the compressed
+// archive (archive.h); a slot is only overwritten once its block has been archived.
+//
+// Commits are group-committed: ledger_append only copies the record into the mapping;
+// every `group_commit` blocks (or LEDGER_SYNC_INTERVAL_MS) ledger_sync flushes the new
+// records with msync, then advances synced_count in the header. After a crash only the
+// records past synced_count are checked, so recovery time does not grow with the chain.
+Blockchain* ledger_open(const char* path, const Config* config);   // Controller: cria ou recupera
+Blockchain* ledger_attach(const char* path, const Config* config); // Validator: mapeia o ledger aberto
+int ledger_append(Blockchain* chain, const TransactionBlock* block); // 0, ou -1 se sem espaço
+int ledger_sync(Blockchain* chain);                                  // Group commit: 0 ou -1
+int ledger_sync_if_due(Blockchain* chain);                           // Sync se o grupo encheu ou envelheceu
+int ledger_has_pending(const Blockchain* chain);                     // Registos por sincronizar
+void ledger_close(Blockchain* chain, int seal);                      // seal: footer (shutdown limpo)
+
+// Bloco de qualquer altura: da janela em memória se ainda lá estiver, senão do arquivo
+int ledger_read_block(Blockchain* chain, uint64_t height, TransactionBlock* out);   // 0 ou -1
+
+uint32_t ledger_crc32c(uint32_t crc, const void* data, size_t len);
+
+#endif
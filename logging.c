@@ -1,9 +1,16 @@
 #include "logging.h"
+#include "common.h"     // CACHE_LINE_SIZE
+#include "futex.h"
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
 #include <semaphore.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -12,6 +19,56 @@ static int log_initialized = 0;
 static sem_t *log_sem = NULL;
 
 #define LOG_SEM_NAME "/log_mutex"
+#define LOG_SHM "/log_shm"
+
+#define LOG_MAX_WRITERS 32        // Rings (threads com log assíncrono em simultâneo)
+#define LOG_RING_RECORDS 256      // Potência de 2
+#define LOG_RECORD_SIZE 256
+#define LOG_FLUSH_MS 50           // Período máximo entre escritas do flusher
+#define LOG_BATCH_BYTES 65536
+
+// Registo de tamanho fixo; o texto já vem formatado pelo produtor
+typedef struct {
+    uint64_t time_ns;             // CLOCK_REALTIME
+    uint32_t len;
+    char text[LOG_RECORD_SIZE - sizeof(uint64_t) - sizeof(uint32_t)];
+} LogRecord;
+
+// Single-producer/single-consumer ring: one writer thread, drained by the flusher
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t owner;   // pid do dono, 0 = livre
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;    // Escrito pelo produtor
+    _Atomic uint64_t dropped;                           // Mensagens perdidas com o ring cheio
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;    // Escrito pelo flusher
+    _Alignas(CACHE_LINE_SIZE) LogRecord records[LOG_RING_RECORDS];
+} LogRing;
+
+typedef struct {
+    _Atomic unsigned char levels[LOG_CAT_COUNT];   // Níveis partilhados por todos os processos
+    _Atomic uint32_t doorbell;          // Futex: produtores acordam o flusher com o ring a meio
+    _Atomic uint32_t flusher_waiting;
+    LogRing rings[LOG_MAX_WRITERS];
+} LogShm;
+
+static _Atomic unsigned char local_levels[LOG_CAT_COUNT] = {
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL
+};
+_Atomic unsigned char *log_levels = local_levels;
+
+static const char *category_names[LOG_CAT_COUNT] = {
+    "GENERAL", "MINER", "VALIDATOR", "TXGEN", "SHM", "STATS", "LEDGER"
+};
+
+static LogShm *log_shm = NULL;
+static int log_shm_owner = 0;           // Este processo criou LOG_SHM (e corre o flusher)
+static _Thread_local LogRing *thread_ring = NULL;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static pthread_t flusher_thread;
+static int flusher_running = 0;
+static _Atomic int flusher_stop = 0;
 
 // Initializes the logging system and semaphore
 void log_init(const char *filename) {
@@ -33,12 +90,8 @@ void log_init(const char *filename) {
     }
 }
 
-// Logs a formatted message with timestamp (to stdout and file)
-void log_message(const char *format, ...) {
-    if (!log_initialized) {
-        fprintf(stderr, "ERROR: log_init() was not called before log_message()\n");
-        return;
-    }
+static void log_message_sync(const char *format, va_list ap) {
+    va_list args;
 
     sem_wait(log_sem); // lock
 
@@ -46,15 +99,14 @@ void log_message(const char *format, ...) {
     char timestamp[20];
     strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
 
-    va_list args;
-    va_start(args, format);
+    va_copy(args, ap);
     printf("[%s] ", timestamp);
     vprintf(format, args);
     printf("\n");
     va_end(args);
 
     if (log_file) {
-        va_start(args, format);
+        va_copy(args, ap);
         fprintf(log_file, "[%s] ", timestamp);
         vfprintf(log_file, format, args);
         fprintf(log_file, "\n");
@@ -65,8 +117,334 @@ void log_message(const char *format, ...) {
     sem_post(log_sem); // unlock
 }
 
+// Destrutor da thread: o ring fica livre; os registos pendentes continuam a ser escritos
+static void ring_release(void *ring) {
+    atomic_store(&((LogRing*)ring)->owner, 0);
+}
+
+static void ring_key_create(void) {
+    pthread_key_create(&ring_key, ring_release);
+}
+
+// No filho de um fork o ring herdado (e o segmento) pertencem ao pai
+static void ring_after_fork(void) {
+    thread_ring = NULL;
+    log_shm_owner = 0;
+}
+
+static LogRing* ring_for_thread(void) {
+    if (thread_ring != NULL) {
+        return thread_ring;
+    }
+
+    uint32_t pid = (uint32_t)getpid();
+    for (int i = 0; i < LOG_MAX_WRITERS; i++) {
+        uint32_t expected = 0;
+        if (atomic_compare_exchange_strong(&log_shm->rings[i].owner, &expected, pid)) {
+            thread_ring = &log_shm->rings[i];
+            pthread_once(&ring_key_once, ring_key_create);
+            pthread_setspecific(ring_key, thread_ring);
+            return thread_ring;
+        }
+    }
+    return NULL;   // Sem rings livres: esta thread usa o modo síncrono
+}
+
+// Logs a formatted message with timestamp (to stdout and file)
+void log_message(const char *format, ...) {
+    if (!log_initialized) {
+        fprintf(stderr, "ERROR: log_init() was not called before log_message()\n");
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+
+    LogRing *ring = log_shm != NULL ? ring_for_thread() : NULL;
+    if (ring == NULL) {
+        log_message_sync(format, args);
+        va_end(args);
+        return;
+    }
+
+    // Caminho rápido: formata direto para o ring, sem locks nem I/O
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t used = head - atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (used >= LOG_RING_RECORDS) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        va_end(args);
+        return;
+    }
+
+    LogRecord *rec = &ring->records[head & (LOG_RING_RECORDS - 1)];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->time_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    int len = vsnprintf(rec->text, sizeof(rec->text), format, args);
+    va_end(args);
+    rec->len = len < 0 ? 0 : (len >= (int)sizeof(rec->text) ? sizeof(rec->text) - 1 : (uint32_t)len);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    if (used + 1 == LOG_RING_RECORDS / 2 && atomic_load(&log_shm->flusher_waiting)) {
+        atomic_fetch_add(&log_shm->doorbell, 1);
+        futex_wake(&log_shm->doorbell, 1);
+    }
+}
+
+static LogShm* map_log_shm(int flags) {
+    int fd = shm_open(LOG_SHM, flags, 0666);
+    if (fd == -1) {
+        return NULL;
+    }
+    if ((flags & O_CREAT) && ftruncate(fd, sizeof(LogShm)) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    LogShm *shm = mmap(NULL, sizeof(LogShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return shm == MAP_FAILED ? NULL : shm;
+}
+
+int log_create_async(void) {
+    LogShm *shm = map_log_shm(O_CREAT | O_RDWR);
+    if (shm == NULL) {
+        log_message("ERROR: Failed to create %s, logging stays synchronous", LOG_SHM);
+        return -1;
+    }
+
+    memset(shm, 0, sizeof(LogShm));
+    for (int c = 0; c < LOG_CAT_COUNT; c++) {
+        atomic_store(&shm->levels[c], atomic_load(&local_levels[c]));
+    }
+    pthread_atfork(NULL, NULL, ring_after_fork);
+    log_shm = shm;
+    log_shm_owner = 1;
+    log_levels = shm->levels;
+    LOG_INFO(LOG_CAT_SHM, "SHM: %s created and mapped (%d rings of %d records)", LOG_SHM, LOG_MAX_WRITERS, LOG_RING_RECORDS);
+    return 0;
+}
+
+int log_attach_async(void) {
+    LogShm *shm = map_log_shm(O_RDWR);
+    if (shm == NULL) {
+        return -1;   // Controller não está a correr em modo assíncrono
+    }
+
+    pthread_atfork(NULL, NULL, ring_after_fork);
+    log_shm = shm;
+    log_levels = shm->levels;
+    return 0;
+}
+
+// Escreve o lote no stdout e no ficheiro; o semáforo serializa com escritores síncronos
+static void flush_batch(const char *buf, size_t len) {
+    if (len == 0) {
+        return;
+    }
+
+    sem_wait(log_sem);
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+    if (log_file) {
+        fwrite(buf, 1, len, log_file);
+        fflush(log_file);
+    }
+    sem_post(log_sem);
+}
+
+// Drains every ring, merging records by timestamp, and writes them in batches.
+// localtime_r is called once per distinct second, not once per message.
+static int log_drain(void) {
+    static char batch[LOG_BATCH_BYTES];
+    static time_t cached_sec = -1;
+    static char cached_stamp[24];
+    uint64_t heads[LOG_MAX_WRITERS];
+    uint64_t tails[LOG_MAX_WRITERS];
+    size_t used = 0;
+    int written = 0;
+
+    for (int i = 0; i < LOG_MAX_WRITERS; i++) {
+        heads[i] = atomic_load_explicit(&log_shm->rings[i].head, memory_order_acquire);
+        tails[i] = atomic_load_explicit(&log_shm->rings[i].tail, memory_order_relaxed);
+    }
+
+    for (;;) {
+        int best = -1;
+        for (int i = 0; i < LOG_MAX_WRITERS; i++) {
+            if (tails[i] != heads[i] &&
+                (best < 0 || log_shm->rings[i].records[tails[i] & (LOG_RING_RECORDS - 1)].time_ns <
+                             log_shm->rings[best].records[tails[best] & (LOG_RING_RECORDS - 1)].time_ns)) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+
+        LogRing *ring = &log_shm->rings[best];
+        const LogRecord *rec = &ring->records[tails[best] & (LOG_RING_RECORDS - 1)];
+        time_t sec = (time_t)(rec->time_ns / 1000000000ull);
+        if (sec != cached_sec) {
+            struct tm tm;
+            localtime_r(&sec, &tm);
+            strftime(cached_stamp, sizeof(cached_stamp), "%Y-%m-%d %H:%M:%S", &tm);
+            cached_sec = sec;
+        }
+
+        if (used + rec->len + sizeof(cached_stamp) + 4 > sizeof(batch)) {
+            flush_batch(batch, used);
+            used = 0;
+        }
+        used += (size_t)snprintf(batch + used, sizeof(batch) - used, "[%s] %.*s\n",
+                                 cached_stamp, (int)rec->len, rec->text);
+
+        tails[best]++;
+        atomic_store_explicit(&ring->tail, tails[best], memory_order_release);
+        written++;
+    }
+
+    flush_batch(batch, used);
+    return written;
+}
+
+// Rings de processos que já terminaram (ex.: um txgen) voltam a ficar livres
+static void reclaim_rings(uint64_t reported_drops[]) {
+    for (int i = 0; i < LOG_MAX_WRITERS; i++) {
+        LogRing *ring = &log_shm->rings[i];
+        uint64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != reported_drops[i]) {
+            char line[96];
+            int len = snprintf(line, sizeof(line), "WARNING: %llu log message(s) dropped (ring %d full)\n",
+                               (unsigned long long)(dropped - reported_drops[i]), i);
+            flush_batch(line, (size_t)len);
+            reported_drops[i] = dropped;
+        }
+
+        uint32_t owner = atomic_load(&ring->owner);
+        if (owner != 0 && kill((pid_t)owner, 0) == -1 && errno == ESRCH) {
+            atomic_compare_exchange_strong(&ring->owner, &owner, 0);
+        }
+    }
+}
+
+static void* flusher_main(void *arg) {
+    (void)arg;
+    uint64_t reported_drops[LOG_MAX_WRITERS] = {0};
+    time_t last_reclaim = time(NULL);
+
+    while (!flusher_stop) {
+        uint32_t seen = atomic_load(&log_shm->doorbell);
+        if (log_drain() == 0) {
+            atomic_store(&log_shm->flusher_waiting, 1);
+            futex_wait(&log_shm->doorbell, seen, LOG_FLUSH_MS);
+            atomic_store(&log_shm->flusher_waiting, 0);
+        }
+
+        time_t now = time(NULL);
+        if (now != last_reclaim) {
+            reclaim_rings(reported_drops);
+            last_reclaim = now;
+        }
+    }
+
+    log_drain();
+    return NULL;
+}
+
+int log_start_flusher(void) {
+    if (log_shm == NULL || !log_shm_owner || flusher_running) {
+        return -1;
+    }
+
+    // O flusher não recebe sinais: o SIGINT tem de chegar à thread principal
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    int rc = pthread_create(&flusher_thread, NULL, flusher_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (rc != 0) {
+        log_message("ERROR: Failed to start log flusher thread");
+        return -1;
+    }
+    flusher_running = 1;
+    return 0;
+}
+
+void log_set_level(int category, int level) {
+    if (level < LOG_LEVEL_ERROR) {
+        level = LOG_LEVEL_ERROR;
+    } else if (level > LOG_LEVEL_TRACE) {
+        level = LOG_LEVEL_TRACE;
+    }
+
+    for (int c = 0; c < LOG_CAT_COUNT; c++) {
+        if (category < 0 || category == c) {
+            atomic_store(&log_levels[c], (unsigned char)level);
+        }
+    }
+}
+
+int log_category_from_name(const char *name) {
+    for (int c = 0; c < LOG_CAT_COUNT; c++) {
+        if (strcmp(name, category_names[c]) == 0) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+const char* log_category_name(int category) {
+    return category >= 0 && category < LOG_CAT_COUNT ? category_names[category] : "?";
+}
+
+// Handlers só com atómicos: são async-signal-safe
+static void handle_level_signal(int sig) {
+    for (int c = 0; c < LOG_CAT_COUNT; c++) {
+        unsigned char level = atomic_load(&log_levels[c]);
+        if (sig == SIGUSR1 && level < LOG_LEVEL_TRACE) {
+            atomic_store(&log_levels[c], level + 1);
+        } else if (sig == SIGUSR2 && level > LOG_LEVEL_ERROR) {
+            atomic_store(&log_levels[c], level - 1);
+        }
+    }
+}
+
+void log_install_level_signals(void) {
+    signal(SIGUSR1, handle_level_signal);
+    signal(SIGUSR2, handle_level_signal);
+}
+
 // Cleans up logging resources
 void log_close(void) {
+    if (log_shm != NULL) {
+        if (flusher_running) {
+            flusher_stop = 1;
+            atomic_fetch_add(&log_shm->doorbell, 1);
+            futex_wake(&log_shm->doorbell, 1);
+            pthread_join(flusher_thread, NULL);
+            flusher_running = 0;
+        } else if (log_shm_owner) {
+            log_drain();
+        }
+
+        if (thread_ring != NULL) {
+            ring_release(thread_ring);
+            thread_ring = NULL;
+        }
+        for (int c = 0; c < LOG_CAT_COUNT; c++) {
+            atomic_store(&local_levels[c], atomic_load(&log_shm->levels[c]));
+        }
+        log_levels = local_levels;
+        munmap(log_shm, sizeof(LogShm));
+        if (log_shm_owner) {
+            shm_unlink(LOG_SHM);
+        }
+        log_shm = NULL;
+        log_shm_owner = 0;
+    }
+
     if (log_file) {
         fclose(log_file);
         log_file = NULL;
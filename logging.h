@@ -1,8 +1,88 @@
 #ifndef LOGGING_H
 #define LOGGING_H
 
+#include <stdatomic.h>
+
+// Níveis de severidade (números, para poderem ser comparados pelo pré-processador)
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN  1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_TRACE 4
+
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+
+// Chamadas acima deste nível não geram código (make LOG_COMPILE_LEVEL=<n>)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+typedef enum {
+    LOG_CAT_GENERAL = 0,
+    LOG_CAT_MINER,
+    LOG_CAT_VALIDATOR,
+    LOG_CAT_TXGEN,
+    LOG_CAT_SHM,
+    LOG_CAT_STATS,
+    LOG_CAT_LEDGER,
+    LOG_CAT_COUNT
+} LogCategory;
+
+// Nível atual de cada categoria: local ao processo, ou em LOG_SHM quando o modo
+// assíncrono está ativo (assim um sinal ao controller muda o nível de todos)
+extern _Atomic unsigned char *log_levels;
+
+static inline int log_enabled(int level, LogCategory category) {
+    return level <= atomic_load_explicit(&log_levels[category], memory_order_relaxed);
+}
+
+#define LOG_AT(level, category, ...) \
+    do { if (log_enabled((level), (category))) log_message(__VA_ARGS__); } while (0)
+// Desligado em compilação: os argumentos continuam a ser verificados mas nunca avaliados
+#define LOG_DISABLED(...) \
+    do { if (0) log_message(__VA_ARGS__); } while (0)
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(category, ...) LOG_AT(LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#else
+#define LOG_ERROR(category, ...) LOG_DISABLED(__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(category, ...) LOG_AT(LOG_LEVEL_WARN, category, __VA_ARGS__)
+#else
+#define LOG_WARN(category, ...) LOG_DISABLED(__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(category, ...) LOG_AT(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#else
+#define LOG_INFO(category, ...) LOG_DISABLED(__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(category, ...) LOG_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) LOG_DISABLED(__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(category, ...) LOG_AT(LOG_LEVEL_TRACE, category, __VA_ARGS__)
+#else
+#define LOG_TRACE(category, ...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
 void log_init(const char *filename);
 void log_message(const char *format, ...);
 void log_close(void);
 
-#endif
\ No newline at end of file
+// Modo assíncrono: cada thread escreve num ring próprio em memória partilhada e um
+// único flusher (thread do controller) escreve os registos em lote.
+// Sem o segmento (ou sem ring livre) log_message volta ao modo síncrono.
+int log_create_async(void);     // Controller: cria LOG_SHM, antes dos fork()
+int log_attach_async(void);     // Outros processos (txgen): abre LOG_SHM se existir
+int log_start_flusher(void);    // Controller: depois dos fork()
+
+// Níveis em runtime. SIGUSR1 aumenta e SIGUSR2 diminui o nível de todas as categorias.
+void log_set_level(int category, int level);     // category < 0: todas
+int log_category_from_name(const char *name);    // "MINER" -> LOG_CAT_MINER, ou -1
+const char* log_category_name(int category);
+void log_install_level_signals(void);
+
+#endif
@@ -0,0 +1,199 @@
+#include "merkle.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LEAF_PREFIX 0x00
+#define NODE_PREFIX 0x01
+
+typedef uint8_t MerkleNode[SHA256_DIGEST_SIZE];
+
+static inline void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void put_le64(uint8_t* p, uint64_t v) {
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+// Larguras fixas e little-endian, independentes do padding da struct
+size_t merkle_serialize_tx(const Transaction* tx, uint8_t out[MERKLE_TX_SERIALIZED_SIZE]) {
+    put_le32(out,      (uint32_t)tx->id);
+    put_le32(out + 4,  (uint32_t)tx->reward);
+    put_le32(out + 8,  (uint32_t)tx->sender_id);
+    put_le32(out + 12, (uint32_t)tx->receiver_id);
+    put_le32(out + 16, (uint32_t)tx->value);
+    put_le64(out + 20, (uint64_t)tx->timestamp);
+    return MERKLE_TX_SERIALIZED_SIZE;
+}
+
+// Mensagens de uma folha e de um nó interno já com o padding SHA-256
+static void leaf_message(const Transaction* tx, uint8_t block[SHA256_BLOCK_SIZE]) {
+    block[0] = LEAF_PREFIX;
+    merkle_serialize_tx(tx, block + 1);
+    sha256_pad(block, 1 + MERKLE_TX_SERIALIZED_SIZE);
+}
+
+static void node_message(const uint8_t* left, const uint8_t* right, uint8_t blocks[2 * SHA256_BLOCK_SIZE]) {
+    blocks[0] = NODE_PREFIX;
+    memcpy(blocks + 1, left, SHA256_DIGEST_SIZE);
+    memcpy(blocks + 1 + SHA256_DIGEST_SIZE, right, SHA256_DIGEST_SIZE);
+    sha256_pad(blocks, 1 + 2 * SHA256_DIGEST_SIZE);
+}
+
+static void finish_batch(uint32_t states[][8], MerkleNode* out, int count) {
+    for (int i = 0; i < count; i++) {
+        sha256_state_to_digest(states[i], out[i]);
+    }
+}
+
+// Folhas em lotes de MERKLE_BATCH: uma compressão multi-buffer por lote
+static void hash_leaves(const Transaction* txs, int n, MerkleNode* out) {
+    uint32_t states[MERKLE_BATCH][8];
+    uint8_t messages[MERKLE_BATCH][SHA256_BLOCK_SIZE];
+    const uint8_t* blocks[MERKLE_BATCH];
+
+    for (int base = 0; base < n; base += MERKLE_BATCH) {
+        int count = n - base < MERKLE_BATCH ? n - base : MERKLE_BATCH;
+        for (int i = 0; i < count; i++) {
+            leaf_message(&txs[base + i], messages[i]);
+            sha256_init_state(states[i]);
+            blocks[i] = messages[i];
+        }
+        sha256_compress_multi(states, blocks, count);
+        finish_batch(states, out + base, count);
+    }
+}
+
+// Reduz um nível em `nodes`, no próprio array: o nó i do nível seguinte é o par (2i, 2i+1).
+// Devolve o número de nós do nível seguinte
+static int reduce_level(MerkleNode* nodes, int count) {
+    uint32_t states[MERKLE_BATCH][8];
+    uint8_t messages[MERKLE_BATCH][2 * SHA256_BLOCK_SIZE];
+    const uint8_t* blocks[MERKLE_BATCH];
+    int pairs = count / 2;
+
+    for (int base = 0; base < pairs; base += MERKLE_BATCH) {
+        int batch = pairs - base < MERKLE_BATCH ? pairs - base : MERKLE_BATCH;
+        for (int i = 0; i < batch; i++) {
+            int p = base + i;
+            node_message(nodes[2 * p], nodes[2 * p + 1], messages[i]);
+            sha256_init_state(states[i]);
+            blocks[i] = messages[i];
+        }
+        sha256_compress_multi(states, blocks, batch);
+        for (int i = 0; i < batch; i++) {
+            blocks[i] = messages[i] + SHA256_BLOCK_SIZE;
+        }
+        sha256_compress_multi(states, blocks, batch);
+        finish_batch(states, nodes + base, batch);
+    }
+    if (count % 2) {
+        memmove(nodes[pairs], nodes[count - 1], SHA256_DIGEST_SIZE);   // Sem irmão: sobe igual
+    }
+    return pairs + count % 2;
+}
+
+// Buffer dos nós por thread, reutilizado entre blocos (miners e validator chamam isto por bloco)
+static MerkleNode* node_buffer(int n) {
+    static _Thread_local MerkleNode* buffer = NULL;
+    static _Thread_local int capacity = 0;
+    if (n > capacity) {
+        MerkleNode* grown = realloc(buffer, (size_t)n * sizeof(MerkleNode));
+        if (grown == NULL) {
+            LOG_ERROR(LOG_CAT_GENERAL, "ERROR: Cannot allocate %d Merkle nodes", n);
+            exit(EXIT_FAILURE);
+        }
+        buffer = grown;
+        capacity = n;
+    }
+    return buffer;
+}
+
+static void hash_node(const uint8_t* left, const uint8_t* right, uint8_t out[SHA256_DIGEST_SIZE]) {
+    uint8_t blocks[2 * SHA256_BLOCK_SIZE];
+    uint32_t state[8];
+    node_message(left, right, blocks);
+    sha256_init_state(state);
+    sha256_compress(state, blocks);
+    sha256_compress(state, blocks + SHA256_BLOCK_SIZE);
+    sha256_state_to_digest(state, out);
+}
+
+void merkle_leaf_hash(const Transaction* tx, uint8_t out[SHA256_DIGEST_SIZE]) {
+    uint8_t block[SHA256_BLOCK_SIZE];
+    uint32_t state[8];
+    leaf_message(tx, block);
+    sha256_init_state(state);
+    sha256_compress(state, block);
+    sha256_state_to_digest(state, out);
+}
+
+void merkle_root(const Transaction* txs, int n, uint8_t root[MERKLE_ROOT_SIZE]) {
+    if (n <= 0) {
+        memset(root, 0, MERKLE_ROOT_SIZE);
+        return;
+    }
+    MerkleNode* nodes = node_buffer(n);
+    hash_leaves(txs, n, nodes);
+    while (n > 1) {
+        n = reduce_level(nodes, n);
+    }
+    memcpy(root, nodes[0], MERKLE_ROOT_SIZE);
+}
+
+int merkle_block_matches(const TransactionBlock* block, int n_tx) {
+    uint8_t root[MERKLE_ROOT_SIZE];
+    merkle_root(block->transactions, n_tx, root);
+    return memcmp(root, block->merkle_root, MERKLE_ROOT_SIZE) == 0;
+}
+
+int merkle_proof(const Transaction* txs, int n, int index, MerkleProof* proof) {
+    if (n <= 0 || index < 0 || index >= n) {
+        return -1;
+    }
+    MerkleNode* nodes = node_buffer(n);
+    hash_leaves(txs, n, nodes);
+
+    proof->index = (uint32_t)index;
+    proof->leaf_count = (uint32_t)n;
+    proof->depth = 0;
+    for (int i = index; n > 1; i /= 2) {
+        int sibling = i ^ 1;
+        if (sibling < n) {
+            memcpy(proof->siblings[proof->depth++], nodes[sibling], SHA256_DIGEST_SIZE);
+        }
+        n = reduce_level(nodes, n);
+    }
+    return 0;
+}
+
+// Refaz só o caminho da folha até à raiz: um hash por nível
+int merkle_verify(const Transaction* tx, const MerkleProof* proof, const uint8_t root[MERKLE_ROOT_SIZE]) {
+    if (proof->index >= proof->leaf_count || proof->depth < 0 || proof->depth > MERKLE_MAX_DEPTH) {
+        return 0;
+    }
+    uint8_t hash[SHA256_DIGEST_SIZE];
+    merkle_leaf_hash(tx, hash);
+
+    int used = 0;
+    uint32_t n = proof->leaf_count;
+    for (uint32_t i = proof->index; n > 1; i /= 2, n = (n + 1) / 2) {
+        if ((i ^ 1) >= n) {
+            continue;   // Nó sem irmão neste nível
+        }
+        if (used == proof->depth) {
+            return 0;
+        }
+        if (i % 2) {
+            hash_node(proof->siblings[used++], hash, hash);
+        } else {
+            hash_node(hash, proof->siblings[used++], hash);
+        }
+    }
+    return used == proof->depth && memcmp(hash, root, MERKLE_ROOT_SIZE) == 0;
+}
@@ -0,0 +1,40 @@
+#ifndef MERKLE_H
+#define MERKLE_H
+
+#include <stdint.h>
+#include "common.h"
+#include "sha256.h"
+
+// Bytes of one serialized transaction: id, reward, sender, receiver, value (int32) + timestamp (int64)
+#define MERKLE_TX_SERIALIZED_SIZE 28
+#define MERKLE_MAX_DEPTH 32              // Suficiente para 2^32 transações por bloco
+#define MERKLE_BATCH 64                  // Nós comprimidos por chamada ao kernel multi-buffer
+
+// Merkle tree over the transactions of a block:
+//   leaf  = SHA-256(0x00 || transaction)          one compression (29 bytes + padding)
+//   inner = SHA-256(0x01 || left || right)        two compressions
+// The prefixes keep a leaf from being passed off as an inner node. A node without a
+// sibling (odd count) is carried up unchanged instead of being paired with itself, so
+// two different transaction lists never share a root.
+//
+// Each level is hashed in batches through sha256_compress_multi, so the leaves and the
+// lower levels use the SSE4.1/AVX2 kernels that the PoW search uses.
+size_t merkle_serialize_tx(const Transaction* tx, uint8_t out[MERKLE_TX_SERIALIZED_SIZE]);
+void merkle_leaf_hash(const Transaction* tx, uint8_t out[SHA256_DIGEST_SIZE]);
+void merkle_root(const Transaction* txs, int n, uint8_t root[MERKLE_ROOT_SIZE]);   // n == 0: zeros
+int merkle_block_matches(const TransactionBlock* block, int n_tx);                 // Raiz do cabeçalho confere
+
+// Inclusion proof for one transaction: the sibling hashes on the path to the root.
+// Its size and the verification cost are O(log n); the verifier only needs the
+// transaction, the proof and the root from the block header.
+typedef struct {
+    uint32_t index;         // Posição da transação no bloco
+    uint32_t leaf_count;    // Transações no bloco (define onde há nós sem irmão)
+    int depth;              // Irmãos em siblings
+    uint8_t siblings[MERKLE_MAX_DEPTH][SHA256_DIGEST_SIZE];
+} MerkleProof;
+
+int merkle_proof(const Transaction* txs, int n, int index, MerkleProof* proof);    // 0 ou -1
+int merkle_verify(const Transaction* tx, const MerkleProof* proof, const uint8_t root[MERKLE_ROOT_SIZE]);   // 1 se pertence
+
+#endif
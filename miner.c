@@ -8,90 +8,253 @@
 #include "miner.h"
 #include "logging.h"
 #include "common.h"
-#include <semaphore.h>
+#include "pow.h"
+#include "merkle.h"
+#include "block_ring.h"
+#include "tx_pool.h"
+#include "trace.h"
+#include "stats.h"
 #include <sys/mman.h>  
 #include <sys/stat.h>
 
+// Threads that mine the same candidate block. The leader assembles the block and
+// publishes a PoW job; every member (leader included) searches a share of the nonces.
+typedef struct MinerTeam {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned generation;   // Incrementado a cada job publicado
+    int active;            // Seguidores ainda a pesquisar o job atual
+    int size;
+    int closed;            // O líder terminou: os seguidores saem
+    PowSearch search;
+} MinerTeam;
+
 static int num_miners;
+static int num_teams;
 static pthread_t* miner_threads = NULL;
 static MinerThreadArgs* thread_args = NULL;
+static MinerTeam* miner_teams = NULL;
+static BlockRing* block_ring = NULL;
 static volatile sig_atomic_t running_miner = 1;
 
-sem_t *sem_mutex = NULL;
-sem_t *sem_full = NULL;
-sem_t *sem_empty = NULL;
-
 void handle_sigint_miner(int sig) {
     (void)sig;
     running_miner = 0;  // Mudar a variável de controle apenas para o miner
-    log_message("INFO: SIGINT received by miner process, stopping mining...");
+    LOG_INFO(LOG_CAT_MINER, "INFO: SIGINT received by miner process, stopping mining...");
+}
+
+static void log_thread_hash_rate(int id, const PowStats* stats) {
+    LOG_INFO(LOG_CAT_MINER, "MINER: Thread %d searched %llu nonces (%.0f H/s, %s)",
+                id, (unsigned long long)stats->hashes,
+                stats->seconds > 0 ? stats->hashes / stats->seconds : 0.0,
+                sha256_impl_name(sha256_get_impl()));
+}
+
+// Followers wait for the leader's job, search their share and report back.
+// Every published job is acknowledged (active--), even after SIGINT: the leader waits
+// for all of them. Followers only leave once the leader has closed the team.
+static void miner_team_follow(MinerThreadArgs* args) {
+    MinerTeam* team = args->team;
+    unsigned seen = 0;
+
+    while (1) {
+        pthread_mutex_lock(&team->lock);
+        while (team->generation == seen && !team->closed) {
+            pthread_cond_wait(&team->cond, &team->lock);
+        }
+        if (team->generation == seen) {
+            // Equipa fechada e nenhum job por confirmar
+            pthread_mutex_unlock(&team->lock);
+            break;
+        }
+        seen = team->generation;
+        pthread_mutex_unlock(&team->lock);
+
+        // Depois do SIGINT pow_search_work volta logo; o job é só confirmado
+        PowStats stats = {0, 0};
+        pow_search_work(&team->search, args->rank, &running_miner, &stats);
+        log_thread_hash_rate(args->id, &stats);
+        STATS_ADD(hashes, stats.hashes);
+
+        pthread_mutex_lock(&team->lock);
+        if (--team->active == 0) {
+            pthread_cond_broadcast(&team->cond);
+        }
+        pthread_mutex_unlock(&team->lock);
+    }
 }
 
-void send_block_to_validator(int fifo_fd, TransactionBlock* b) {
-    ssize_t bytes_written = write(fifo_fd, b, sizeof(TransactionBlock));
-    if (bytes_written == sizeof(TransactionBlock)) {
-        log_message("MINER: Block sent to Validator (ID=%d)", b->txb_id);
-    } else {
-        log_message("ERROR: Incomplete block write to Validator FIFO");
+// Slots reservados pelo bloco que a equipa está a minerar
+typedef struct {
+    int owner;
+    const int* slots;
+    int count;
+} BlockLeases;
+
+// Chamado a cada recarga de nonces: mantém as reservas vivas enquanto o PoW demora
+static void renew_block_leases(void* ctx) {
+    const BlockLeases* leases = ctx;
+    tx_pool_renew(tx_pool_ptr, leases->slots, leases->count, leases->owner);
+}
+
+// Leader side: mines `block` together with the rest of the team. Returns 0 when solved.
+static int miner_team_mine(MinerThreadArgs* args, TransactionBlock* block, BlockLeases* leases) {
+    MinerTeam* team = args->team;
+
+    while (running_miner) {
+        pow_search_init(&team->search, block, global_config.pow_difficulty, team->size);
+        team->search.on_refill = renew_block_leases;
+        team->search.refill_ctx = leases;
+
+        pthread_mutex_lock(&team->lock);
+        if (!running_miner) {
+            // SIGINT depois do teste do ciclo: fecha a equipa em vez de publicar um job
+            team->closed = 1;
+            pthread_cond_broadcast(&team->cond);
+            pthread_mutex_unlock(&team->lock);
+            break;
+        }
+        team->active = team->size - 1;
+        team->generation++;
+        pthread_cond_broadcast(&team->cond);
+        pthread_mutex_unlock(&team->lock);
+
+        PowStats stats = {0, 0};
+        pow_search_work(&team->search, 0, &running_miner, &stats);
+        log_thread_hash_rate(args->id, &stats);
+        STATS_ADD(hashes, stats.hashes);
+
+        // Espera que todos os seguidores larguem o job antes de o reutilizar
+        pthread_mutex_lock(&team->lock);
+        while (team->active > 0) {
+            pthread_cond_wait(&team->cond, &team->lock);
+        }
+        pthread_mutex_unlock(&team->lock);
+
+        if (pow_search_solution(&team->search, &block->nonce)) {
+            return 0;
+        }
+        // Espaço de nonces esgotado: muda o timestamp e publica um novo job
+        block->timestamp++;
     }
+    return -1;
+}
+
+static void miner_team_close(MinerTeam* team) {
+    pthread_mutex_lock(&team->lock);
+    team->closed = 1;
+    pthread_cond_broadcast(&team->cond);
+    pthread_mutex_unlock(&team->lock);
 }
 
 // Function executed by each miner thread
 void* miner_thread_func(void *arg) {
     MinerThreadArgs* args = (MinerThreadArgs*)arg;
 
-    int fifo_fd = args->fifo_fd;
+    if (args->rank != 0) {
+        miner_team_follow(args);
+        LOG_INFO(LOG_CAT_MINER, "INFO: Miner thread %d stopping", args->id);
+        return NULL;
+    }
 
-    TransactionBlock block;
     int stored_count = 0;
+    int block_counter = 0;
+    BlockRingSlot* slot = NULL;
+    TransactionBlock* block = NULL;
+    int* claimed_slots = malloc(sizeof(int) * global_config.transactions_per_block);
+
+    if (claimed_slots == NULL) {
+        LOG_ERROR(LOG_CAT_MINER, "ERROR: Miner %d failed to allocate claim buffer", args->id);
+        miner_team_close(args->team);
+        return NULL;
+    }
 
     while (running_miner) {
-        log_message("INFO: Miner %d is checking for transactions...", args->id);
-
-        stored_count = 0;
-
-        sem_wait(sem_full);    // Wait for a transaction to be available
-        sem_wait(sem_mutex);   // Lock the pool for safe access
-        
-        for (int i = 0; i < global_config.pool_size && stored_count < global_config.transactions_per_block; i++) {
-            // Check if the transaction is not empty
-            if (!tx_pool_ptr->transactions_pending_set[i].empty) {
-                // Store the transaction in the block's transactions array
-                block.transactions[stored_count] = tx_pool_ptr->transactions_pending_set[i];
-                stored_count++;
-
-                log_message("Stored Transaction ID: %d, Reward: %d, From: %d, To: %d, Value: %d, Age: %d",
-                            block.transactions[stored_count - 1].id,
-                            block.transactions[stored_count - 1].reward,
-                            block.transactions[stored_count - 1].sender_id,
-                            block.transactions[stored_count - 1].receiver_id,
-                            block.transactions[stored_count - 1].value,
-                            block.transactions[stored_count - 1].age);
+        // O bloco candidato é montado e minerado diretamente num slot do ring partilhado
+        if (slot == NULL) {
+            slot = block_ring_acquire(block_ring, args->id, &running_miner);
+            if (slot == NULL) {
+                break;
             }
+            block = block_ring_slot_block(slot);
+        }
 
+        // Dorme no futex da pool até haver transações para um bloco completo
+        if (!tx_pool_wait_ready(tx_pool_ptr, 1000)) {
+            continue;
         }
+        uint64_t woken_ns = trace_now_ns();
+        LOG_DEBUG(LOG_CAT_MINER, "INFO: Miner %d is checking for transactions...", args->id);
+
+        // Reserva (lease) as transações de maior reward (e mais antigas) em nome deste miner
+        stored_count = tx_pool_claim(tx_pool_ptr, args->id, block->transactions, claimed_slots,
+                                     global_config.transactions_per_block);
+        for (int i = 0; i < stored_count; i++) {
+            trace_tx(TRACE_TX_CLAIM, block->transactions[i].id, claimed_slots[i], args->id,
+                     block->transactions[i].reward);
+            LOG_DEBUG(LOG_CAT_MINER, "Stored Transaction ID: %d, Reward: %d, From: %d, To: %d, Value: %d, Age: %d",
+                        block->transactions[i].id,
+                        block->transactions[i].reward,
+                        block->transactions[i].sender_id,
+                        block->transactions[i].receiver_id,
+                        block->transactions[i].value,
+                        block->transactions[i].age);
+        }
+
+        tx_pool_get_current_hash(tx_pool_ptr, block->previous_block_hash);
 
-        sem_post(sem_mutex);   // Release the lock after accessing the pool
-        sem_post(sem_full); 
-        
         if (stored_count == global_config.transactions_per_block) {
-            // Send the block to the validator via FIFO
-            ssize_t bytes_written = write(fifo_fd, &block, sizeof(TransactionBlock));
+            snprintf(block->txb_id, TXB_ID_LEN, "%d-%d-%d", getpid(), args->id, block_counter++);
+            block->timestamp = time(NULL);
+            block->nonce = 0;
+            // O PoW cobre a raiz de Merkle das transações, não o array
+            merkle_root(block->transactions, stored_count, block->merkle_root);
 
-            if (bytes_written == sizeof(TransactionBlock)) {
-                log_message("INFO: Miner %d sent block to validator with %d transactions", args->id, stored_count);
-            } else {
-                log_message("ERROR: Failed to send complete block to validator. Only %zd bytes written.", bytes_written);
+            uint64_t pow_start_ns = trace_now_ns();
+            for (int i = 0; i < stored_count; i++) {
+                STATS_LATENCY(LAT_POOL_WAIT, block->transactions[i].timestamp, woken_ns);
             }
-            break;  // Exit loop since we have sent the block
+            STATS_LATENCY(LAT_ASSEMBLY, woken_ns, pow_start_ns);
+
+            BlockLeases leases = { args->id, claimed_slots, stored_count };
+            if (miner_team_mine(args, block, &leases) != 0) {
+                LOG_INFO(LOG_CAT_MINER, "INFO: Miner %d interrupted during PoW", args->id);
+                for (int i = 0; i < stored_count; i++) {
+                    trace_tx(TRACE_TX_RELEASE, block->transactions[i].id, claimed_slots[i], args->id, 0);
+                    tx_pool_release(tx_pool_ptr, claimed_slots[i], args->id);
+                }
+                break;
+            }
+            LOG_INFO(LOG_CAT_MINER, "MINER: Team of miner %d found nonce %u for block %s",
+                        args->id, block->nonce, block->txb_id);
+
+            STATS_LATENCY(LAT_POW, pow_start_ns, trace_now_ns());
+            STATS_ADD(blocks_mined, 1);
+            trace_block(TRACE_BLOCK_MINED, block->txb_id, args->id, block->nonce, stored_count);
+            trace_block(TRACE_BLOCK_PUBLISH, block->txb_id, args->id, block->nonce, stored_count);
+
+            // Publica o slot: o validator lê o bloco no próprio slot, sem cópias
+            block_ring_publish(block_ring, slot);
+            LOG_INFO(LOG_CAT_MINER, "INFO: Miner %d published block %s to validator with %d transactions",
+                        args->id, block->txb_id, stored_count);
+            slot = NULL;
+            block = NULL;
         } else {
-            log_message("INFO: Miner %d printed %d transactions, waiting for more...", args->id, stored_count);
-            sleep(2);  // Wait for 2 seconds before trying again
+            LOG_DEBUG(LOG_CAT_MINER, "INFO: Miner %d printed %d transactions, waiting for more...", args->id, stored_count);
+            // Outro miner levou parte das transações: devolve-as e volta a esperar pelo futex
+            for (int i = 0; i < stored_count; i++) {
+                trace_tx(TRACE_TX_RELEASE, block->transactions[i].id, claimed_slots[i], args->id, 0);
+                tx_pool_release(tx_pool_ptr, claimed_slots[i], args->id);
+            }
         }
     }
 
-    close_fifo(fifo_fd, VALIDATOR_FIFO);
-    log_message("INFO: Miner thread %d stopping", args->id);
+    if (slot != NULL) {
+        block_ring_abandon(block_ring, slot);
+    }
+    miner_team_close(args->team);
+    free(claimed_slots);
+    LOG_INFO(LOG_CAT_MINER, "INFO: Miner thread %d stopping", args->id);
     return NULL;
 }
 
@@ -101,54 +264,71 @@ void init_miner(int num_threads) {
 
     // Inicializa a memória compartilhada da tx_pool
     open_tx_pool_memory(global_config.pool_size);
-    log_message("MINER: TX_POOL corretamente aberta");
+    LOG_INFO(LOG_CAT_MINER, "MINER: TX_POOL corretamente aberta");
 
-    // Criar semáforos apenas uma vez antes de iniciar as threads
-    sem_t *sem_mutex = sem_open("/sem_mutex", O_CREAT, 0666, 1);  // Mutex para proteger o acesso à tx_pool
-    sem_t *sem_full = sem_open("/sem_full", O_CREAT, 0666, 0);    // Contagem de transações no pool
-
-    if (sem_mutex == SEM_FAILED || sem_full == SEM_FAILED) {
-        log_message("ERROR: Failed to open semaphores.");
-        exit(EXIT_FAILURE);
-    } else {
-        log_message("MINER: Semáforos inicializados corretamente");
-    }
+    block_ring = open_block_ring_memory();
 
     // Alocar memória para threads e seus argumentos
     miner_threads = malloc(num_miners * sizeof(pthread_t));
     thread_args = malloc(num_miners * sizeof(MinerThreadArgs));
 
-    if (!miner_threads || !thread_args) {
-        log_message("ERROR: Failed to allocate memory for miner threads");
+    // Equipas de MINER_TEAM_SIZE threads; a última pode ficar mais pequena
+    int team_size = global_config.miner_team_size;
+    num_teams = (num_miners + team_size - 1) / team_size;
+    miner_teams = calloc(num_teams, sizeof(MinerTeam));
+
+    if (!miner_threads || !thread_args || !miner_teams) {
+        LOG_ERROR(LOG_CAT_MINER, "ERROR: Failed to allocate memory for miner threads");
         exit(EXIT_FAILURE);
     }
+
+    for (int t = 0; t < num_teams; t++) {
+        pthread_mutex_init(&miner_teams[t].lock, NULL);
+        pthread_cond_init(&miner_teams[t].cond, NULL);
+        miner_teams[t].size = (t == num_teams - 1) ? num_miners - t * team_size : team_size;
+    }
+    LOG_INFO(LOG_CAT_MINER, "MINER: %d threads in %d team(s) of up to %d", num_miners, num_teams, team_size);
 }
 
 // Starts all miner threads
 void start_miner_threads() {
     for (int i = 0; i < num_miners; i++) {
         thread_args[i].id = i;
+        thread_args[i].team = &miner_teams[i / global_config.miner_team_size];
+        thread_args[i].rank = i % global_config.miner_team_size;
         if (pthread_create(&miner_threads[i], NULL, miner_thread_func, &thread_args[i]) != 0) {
-            log_message("ERROR: Failed to create miner thread %d", i);
+            LOG_ERROR(LOG_CAT_MINER, "ERROR: Failed to create miner thread %d", i);
             exit(EXIT_FAILURE);
         }
-        log_message("INFO: Successfully created miner thread %d", i);
+        LOG_INFO(LOG_CAT_MINER, "INFO: Successfully created miner thread %d", i);
     }
-    log_message("INFO: All threads were created!");
+    LOG_INFO(LOG_CAT_MINER, "INFO: All threads were created!");
 }
 
 // Waits for all miner threads to finish and frees resources
 void stop_miner_threads() {
+    // Acorda líderes bloqueados à espera de transações para verem running_miner == 0
+    tx_pool_wake_waiters(tx_pool_ptr);
     for (int i = 0; i < num_miners; i++) {
         pthread_join(miner_threads[i], NULL);
     }
 
+    for (int t = 0; t < num_teams; t++) {
+        pthread_mutex_destroy(&miner_teams[t].lock);
+        pthread_cond_destroy(&miner_teams[t].cond);
+    }
+
     free(miner_threads);
     free(thread_args);
+    free(miner_teams);
     miner_threads = NULL;
     thread_args = NULL;
+    miner_teams = NULL;
+
+    close_block_ring_memory(block_ring);
+    block_ring = NULL;
 
-    log_message("INFO: Stopped all miner threads");
+    LOG_INFO(LOG_CAT_MINER, "INFO: Stopped all miner threads");
 }
 
 // Entry point for the miner process
@@ -163,5 +343,5 @@ void run_miner_process(int num_threads) {
     }
 
     stop_miner_threads();
-    log_message("INFO: Miner process exiting");
+    LOG_INFO(LOG_CAT_MINER, "INFO: Miner process exiting");
 }
\ No newline at end of file
@@ -1,9 +1,12 @@
 #ifndef MINER_H
 #define MINER_H
 
+struct MinerTeam;
+
 typedef struct {
     int id;        // ID da thread
-    int fifo_fd;   // Descritor de arquivo do FIFO
+    struct MinerTeam* team;  // Equipa que minera o mesmo bloco candidato
+    int rank;                // Posição na equipa (0 = líder, monta o bloco)
 } MinerThreadArgs;
 void run_miner_process(int num_threads);
 
@@ -0,0 +1,347 @@
+#include "pow.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static inline void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void put_le64(uint8_t* p, uint64_t v) {
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+size_t pow_prefix_len(void) {
+    size_t raw = TXB_ID_LEN + HASH_SIZE + 8 + MERKLE_ROOT_SIZE;
+    return (raw + SHA256_BLOCK_SIZE - 1) & ~(size_t)(SHA256_BLOCK_SIZE - 1);
+}
+
+size_t pow_header_len(void) {
+    return pow_prefix_len() + 4;
+}
+
+// Serializa os campos do bloco com larguras fixas (independente do padding da struct).
+// O prefixo é completado com zeros até 64 bytes e o nonce ocupa os últimos 4 bytes.
+size_t pow_serialize_header(const TransactionBlock* block, uint8_t* out) {
+    uint8_t* p = out;
+    size_t prefix = pow_prefix_len();
+
+    memcpy(p, block->txb_id, TXB_ID_LEN);
+    p += TXB_ID_LEN;
+    memcpy(p, block->previous_block_hash, HASH_SIZE);
+    p += HASH_SIZE;
+    put_le64(p, (uint64_t)block->timestamp);
+    p += 8;
+    memcpy(p, block->merkle_root, MERKLE_ROOT_SIZE);
+    p += MERKLE_ROOT_SIZE;
+
+    memset(p, 0, prefix - (size_t)(p - out));
+    p = out + prefix;
+
+    put_le32(p, block->nonce);
+    p += 4;
+
+    return (size_t)(p - out);
+}
+
+// O cabeçalho tem tamanho fixo: serializa na stack
+#define POW_PREFIX_MAX ((TXB_ID_LEN + HASH_SIZE + 8 + MERKLE_ROOT_SIZE + SHA256_BLOCK_SIZE - 1) & ~(SHA256_BLOCK_SIZE - 1))
+
+void pow_job_init(PowJob* job, const TransactionBlock* block) {
+    size_t len = pow_header_len();
+    size_t prefix = pow_prefix_len();
+    uint8_t buf[POW_PREFIX_MAX + SHA256_BLOCK_SIZE];
+
+    pow_serialize_header(block, buf);
+    sha256_pad(buf, len);   // len + 9 <= prefix + 64, logo o padding cabe no último bloco
+
+    sha256_midstate(&job->mid, buf, prefix);
+    memcpy(job->tail, buf + prefix, SHA256_BLOCK_SIZE);
+}
+
+void pow_job_digest(const PowJob* job, uint32_t nonce, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint32_t state[8];
+    uint8_t tail[SHA256_BLOCK_SIZE];
+
+    memcpy(state, job->mid.h, sizeof(state));
+    memcpy(tail, job->tail, SHA256_BLOCK_SIZE);
+    put_le32(tail, nonce);
+    sha256_compress(state, tail);
+    sha256_state_to_digest(state, digest);
+}
+
+int pow_job_search(const PowJob* job, uint32_t first, uint32_t count, int difficulty,
+                   uint32_t* nonce_out, uint64_t* hashes) {
+    int lanes = sha256_impl_lanes(sha256_get_impl());
+    uint32_t states[SHA256_MAX_LANES][8];
+    uint8_t tails[SHA256_MAX_LANES][SHA256_BLOCK_SIZE];
+    const uint8_t* blocks[SHA256_MAX_LANES];
+
+    for (int l = 0; l < lanes; l++) {
+        memcpy(tails[l], job->tail, SHA256_BLOCK_SIZE);
+        blocks[l] = tails[l];
+    }
+
+    uint64_t end = (uint64_t)first + count;
+    for (uint64_t nonce = first; nonce < end; nonce += lanes) {
+        int n = (end - nonce < (uint64_t)lanes) ? (int)(end - nonce) : lanes;
+
+        for (int l = 0; l < n; l++) {
+            put_le32(tails[l], (uint32_t)(nonce + l));
+            memcpy(states[l], job->mid.h, sizeof(states[l]));
+        }
+        sha256_compress_multi(states, blocks, n);
+
+        for (int l = 0; l < n; l++) {
+            if (pow_state_meets_difficulty(states[l], difficulty)) {
+                *nonce_out = (uint32_t)(nonce + l);
+                *hashes += l + 1;
+                return 1;
+            }
+        }
+        *hashes += n;
+    }
+    return 0;
+}
+
+// Checks the leading hex zeros directly on the big-endian state words
+int pow_state_meets_difficulty(const uint32_t state[8], int difficulty) {
+    int full_words = difficulty / 8;
+    for (int i = 0; i < full_words; i++) {
+        if (state[i] != 0) {
+            return 0;
+        }
+    }
+    int rem = difficulty % 8;
+    return rem == 0 || (state[full_words] >> (32 - 4 * rem)) == 0;
+}
+
+int pow_digest_meets_difficulty(const uint8_t digest[SHA256_DIGEST_SIZE], int difficulty) {
+    int full_bytes = difficulty / 2;
+    for (int i = 0; i < full_bytes; i++) {
+        if (digest[i] != 0) {
+            return 0;
+        }
+    }
+    if (difficulty % 2 && (digest[full_bytes] & 0xf0) != 0) {
+        return 0;
+    }
+    return 1;
+}
+
+void pow_block_digest(const TransactionBlock* block, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    PowJob job;
+    pow_job_init(&job, block);
+    pow_job_digest(&job, block->nonce, digest);
+}
+
+void pow_block_hash(const TransactionBlock* block, char hex[HASH_SIZE]) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    pow_block_digest(block, digest);
+    sha256_digest_to_hex(digest, hex);
+}
+
+int pow_verify(const TransactionBlock* block, int difficulty) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    pow_block_digest(block, digest);
+    return pow_digest_meets_difficulty(digest, difficulty);
+}
+
+void pow_verify_batch(const TransactionBlock* const blocks[], int n, int difficulty, int results[]) {
+    size_t len = pow_header_len();
+    size_t padded = sha256_padded_len(len);
+    uint8_t headers[SHA256_MAX_LANES][POW_PREFIX_MAX + SHA256_BLOCK_SIZE];
+    uint32_t states[SHA256_MAX_LANES][8];
+    const uint8_t* chunks[SHA256_MAX_LANES];
+
+    for (int base = 0; base < n; base += SHA256_MAX_LANES) {
+        int lanes = n - base < SHA256_MAX_LANES ? n - base : SHA256_MAX_LANES;
+        for (int l = 0; l < lanes; l++) {
+            pow_serialize_header(blocks[base + l], headers[l]);
+            sha256_pad(headers[l], len);
+            sha256_init_state(states[l]);
+        }
+        for (size_t off = 0; off < padded; off += SHA256_BLOCK_SIZE) {
+            for (int l = 0; l < lanes; l++) {
+                chunks[l] = headers[l] + off;
+            }
+            sha256_compress_multi(states, chunks, lanes);
+        }
+        for (int l = 0; l < lanes; l++) {
+            results[base + l] = pow_state_meets_difficulty(states[l], difficulty);
+        }
+    }
+}
+
+#define RANGE_PACK(next, end) (((uint64_t)(end) << 32) | (uint32_t)(next))
+#define RANGE_NEXT(r) ((uint32_t)(r))
+#define RANGE_END(r) ((uint32_t)((r) >> 32))
+
+void pow_search_init(PowSearch* search, const TransactionBlock* block, int difficulty, int workers) {
+    pow_job_init(&search->job, block);
+    search->difficulty = difficulty;
+    search->workers = workers < POW_MAX_WORKERS ? workers : POW_MAX_WORKERS;
+    atomic_store(&search->cursor, 0);
+    atomic_store(&search->solution, 0);
+    search->on_refill = NULL;
+    search->refill_ctx = NULL;
+    for (int w = 0; w < POW_MAX_WORKERS; w++) {
+        atomic_store(&search->ranges[w].range, RANGE_PACK(0, 0));
+    }
+    atomic_store(&search->state, POW_SEARCH_RUNNING);
+}
+
+// Takes the upper half of the largest range owned by another worker
+static int pow_search_steal(PowSearch* search, int w) {
+    for (;;) {
+        int victim = -1;
+        uint64_t victim_range = 0;
+        uint32_t best = 0;
+
+        for (int v = 0; v < search->workers; v++) {
+            if (v == w) {
+                continue;
+            }
+            uint64_t r = atomic_load_explicit(&search->ranges[v].range, memory_order_acquire);
+            uint32_t left = RANGE_END(r) - RANGE_NEXT(r);
+            if (RANGE_END(r) > RANGE_NEXT(r) && left > best) {
+                best = left;
+                victim = v;
+                victim_range = r;
+            }
+        }
+
+        // Não vale a pena roubar menos do que um sub-lote
+        if (victim < 0 || best < 2 * POW_SUB_BATCH) {
+            return 0;
+        }
+
+        uint32_t next = RANGE_NEXT(victim_range);
+        uint32_t end = RANGE_END(victim_range);
+        uint32_t mid = next + best / 2;
+        if (atomic_compare_exchange_weak(&search->ranges[victim].range, &victim_range, RANGE_PACK(next, mid))) {
+            atomic_store_explicit(&search->ranges[w].range, RANGE_PACK(mid, end), memory_order_release);
+            return 1;
+        }
+    }
+}
+
+// Refills the worker's range from the shared cursor, or by stealing once the cursor is exhausted.
+// *top is set when the chunk reaches the end of the space: POW_LAST_NONCE is then the worker's too.
+static int pow_search_refill(PowSearch* search, int w, int* top) {
+    if (search->on_refill) {
+        search->on_refill(search->refill_ctx);
+    }
+    uint64_t start = atomic_fetch_add(&search->cursor, POW_CHUNK_SIZE);
+    *top = 0;
+    if (start < POW_NONCE_LIMIT) {
+        uint64_t end = start + POW_CHUNK_SIZE;
+        if (end >= POW_NONCE_LIMIT) {
+            end = POW_LAST_NONCE;
+            *top = 1;
+        }
+        atomic_store_explicit(&search->ranges[w].range, RANGE_PACK(start, end), memory_order_release);
+        return 1;
+    }
+    return pow_search_steal(search, w);
+}
+
+// Only one worker can win: it publishes the nonce before the SOLVED state readers check
+static PowResult pow_search_solved(PowSearch* search, uint32_t nonce) {
+    int expected = POW_SEARCH_RUNNING;
+    if (!atomic_compare_exchange_strong(&search->state, &expected, POW_SEARCH_SOLVING)) {
+        return POW_RESULT_DONE;
+    }
+    atomic_store_explicit(&search->solution, nonce, memory_order_relaxed);
+    atomic_store_explicit(&search->state, POW_SEARCH_SOLVED, memory_order_release);
+    return POW_RESULT_FOUND;
+}
+
+PowResult pow_search_work(PowSearch* search, int w, const volatile sig_atomic_t* running, PowStats* stats) {
+    _Atomic uint64_t* own = &search->ranges[w].range;
+    uint64_t hashes = 0;
+    PowResult result = POW_RESULT_DONE;
+    double start = now_seconds();
+
+    while (atomic_load_explicit(&search->state, memory_order_relaxed) == POW_SEARCH_RUNNING && *running) {
+        // Reserva o próximo sub-lote do próprio intervalo (pode competir com um ladrão)
+        uint64_t r = atomic_load_explicit(own, memory_order_acquire);
+        uint32_t next = RANGE_NEXT(r);
+        uint32_t end = RANGE_END(r);
+
+        if (next >= end) {
+            int top;
+            if (!pow_search_refill(search, w, &top)) {
+                result = POW_RESULT_EXHAUSTED;
+                break;
+            }
+            uint32_t nonce;
+            if (top && pow_job_search(&search->job, POW_LAST_NONCE, 1, search->difficulty, &nonce, &hashes)) {
+                result = pow_search_solved(search, nonce);
+                break;
+            }
+            continue;
+        }
+
+        uint32_t count = end - next < POW_SUB_BATCH ? end - next : POW_SUB_BATCH;
+        if (!atomic_compare_exchange_weak(own, &r, RANGE_PACK(next + count, end))) {
+            continue;
+        }
+
+        uint32_t nonce;
+        if (pow_job_search(&search->job, next, count, search->difficulty, &nonce, &hashes)) {
+            result = pow_search_solved(search, nonce);
+            break;
+        }
+    }
+
+    atomic_store_explicit(own, RANGE_PACK(0, 0), memory_order_release);
+
+    if (stats) {
+        stats->hashes += hashes;
+        stats->seconds += now_seconds() - start;
+    }
+    return result;
+}
+
+int pow_search_solution(PowSearch* search, uint32_t* nonce) {
+    if (atomic_load_explicit(&search->state, memory_order_acquire) != POW_SEARCH_SOLVED) {
+        return 0;
+    }
+    *nonce = atomic_load_explicit(&search->solution, memory_order_relaxed);
+    return 1;
+}
+
+int pow_mine(TransactionBlock* block, int difficulty,
+             const volatile sig_atomic_t* running, PowStats* stats) {
+    static _Thread_local PowSearch search;
+    PowStats local = {0, 0};
+    int found = -1;
+
+    // Pesquisa com um único worker; esgotado o espaço de nonces, muda o timestamp
+    while (found < 0 && *running) {
+        pow_search_init(&search, block, difficulty, 1);
+        if (pow_search_work(&search, 0, running, &local) == POW_RESULT_FOUND) {
+            pow_search_solution(&search, &block->nonce);
+            found = 0;
+        } else {
+            block->timestamp++;
+        }
+    }
+
+    if (stats) {
+        *stats = local;
+    }
+    return found;
+}
@@ -0,0 +1,104 @@
+#ifndef POW_H
+#define POW_H
+
+#include <stdint.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include "common.h"
+#include "sha256.h"
+
+#define POW_DEFAULT_DIFFICULTY 4   // Número de dígitos hexadecimais a zero no início do hash
+#define POW_MAX_DIFFICULTY 64
+
+typedef struct {
+    uint64_t hashes;     // Number of nonces tried
+    double seconds;      // Wall-clock time spent searching
+} PowStats;
+
+// Header layout:
+//   [txb_id | previous_block_hash | timestamp | merkle_root | zeros up to a 64-byte boundary] [nonce]
+// The transactions are committed through the Merkle root (merkle.h), so the header has a
+// fixed size whatever the block size. The nonce starts the last 64-byte chunk, so every
+// nonce try costs exactly one compression on top of the midstate of the fixed prefix.
+size_t pow_prefix_len(void);              // Multiple of 64
+size_t pow_header_len(void);              // pow_prefix_len() + 4
+size_t pow_serialize_header(const TransactionBlock* block, uint8_t* out);
+
+// Per-candidate-block search context: midstate of the prefix plus the padded nonce chunk
+typedef struct {
+    Sha256Midstate mid;
+    uint8_t tail[SHA256_BLOCK_SIZE];
+} PowJob;
+
+void pow_job_init(PowJob* job, const TransactionBlock* block);
+void pow_job_digest(const PowJob* job, uint32_t nonce, uint8_t digest[SHA256_DIGEST_SIZE]);
+// Tries nonces [first, first + count); returns 1 and sets *nonce_out on success.
+// *hashes is incremented by the number of nonces actually tried.
+int pow_job_search(const PowJob* job, uint32_t first, uint32_t count, int difficulty,
+                   uint32_t* nonce_out, uint64_t* hashes);
+
+int pow_state_meets_difficulty(const uint32_t state[8], int difficulty);
+int pow_digest_meets_difficulty(const uint8_t digest[SHA256_DIGEST_SIZE], int difficulty);
+void pow_block_digest(const TransactionBlock* block, uint8_t digest[SHA256_DIGEST_SIZE]);
+void pow_block_hash(const TransactionBlock* block, char hex[HASH_SIZE]);
+// Só o cabeçalho: a raiz de Merkle é conferida à parte (merkle_block_matches)
+int pow_verify(const TransactionBlock* block, int difficulty);
+// pow_verify de n blocos: os cabeçalhos têm todos o mesmo tamanho, por isso as suas
+// compressões avançam em lockstep no kernel multi-buffer. results[i] = pow_verify(blocks[i])
+void pow_verify_batch(const TransactionBlock* const blocks[], int n, int difficulty, int results[]);
+
+// ---------------------------------------------------------------------------
+// Cooperative search: several threads mining the same candidate block split the
+// nonce space in chunks taken from a shared cursor. Once the cursor runs out, idle
+// threads steal the upper half of the largest range still owned by another thread.
+// ---------------------------------------------------------------------------
+
+#define POW_MAX_WORKERS 64
+#define POW_CHUNK_SIZE (1u << 20)       // Nonces handed out per cursor increment
+#define POW_SUB_BATCH 256               // Nonces claimed from the own range at a time
+#define POW_NONCE_LIMIT 0x100000000ull  // Exclusive upper bound of the searched space
+#define POW_LAST_NONCE 0xffffffffu      // Beyond any [next, end) range with a 32-bit end
+
+typedef enum {
+    POW_SEARCH_RUNNING = 0,
+    POW_SEARCH_SOLVING,         // A worker won and is storing the solution
+    POW_SEARCH_SOLVED,
+} PowSearchState;
+
+typedef enum {
+    POW_RESULT_DONE = 0,        // Another worker solved it or *running dropped to 0
+    POW_RESULT_FOUND,           // This worker found the solution
+    POW_RESULT_EXHAUSTED,       // No nonces left to try
+} PowResult;
+
+// Range owned by one worker, packed as (end << 32) | next so owner and thieves agree via CAS
+typedef struct {
+    _Alignas(64) _Atomic uint64_t range;
+} PowWorkerRange;
+
+typedef struct {
+    PowJob job;
+    int difficulty;
+    int workers;
+    _Alignas(64) _Atomic uint64_t cursor;   // Next nonce not yet handed out
+    _Alignas(64) _Atomic int state;         // PowSearchState
+    _Atomic uint32_t solution;
+    // Optional, called by a worker whenever it refills its range (e.g. to renew the
+    // leases on the block's transactions during a long search). Cleared by pow_search_init.
+    void (*on_refill)(void* ctx);
+    void* refill_ctx;
+    PowWorkerRange ranges[POW_MAX_WORKERS];
+} PowSearch;
+
+void pow_search_init(PowSearch* search, const TransactionBlock* block, int difficulty, int workers);
+// Runs worker `w` until somebody solves the job, the space is exhausted
+// or *running drops to 0. Adds this worker's hashes and search time to *stats.
+PowResult pow_search_work(PowSearch* search, int w, const volatile sig_atomic_t* running, PowStats* stats);
+int pow_search_solution(PowSearch* search, uint32_t* nonce);
+
+// Searches for a nonce satisfying `difficulty`; writes it into block->nonce.
+// block->merkle_root must already be set. Returns 0 when found, -1 when *running drops to 0 first.
+int pow_mine(TransactionBlock* block, int difficulty,
+             const volatile sig_atomic_t* running, PowStats* stats);
+
+#endif
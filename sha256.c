@@ -0,0 +1,347 @@
+#include "sha256.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHA256_HAVE_X86 1
+#endif
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t load_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8)  |  (uint32_t)p[3];
+}
+
+static inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline uint32_t rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+void sha256_init_state(uint32_t state[8]) {
+    memcpy(state, H0, sizeof(H0));
+}
+
+// Portable scalar compression function (FIPS 180-4, secção 6.2.2)
+void sha256_compress(uint32_t state[8], const uint8_t block[SHA256_BLOCK_SIZE]) {
+    uint32_t w[64];
+    for (int t = 0; t < 16; t++) {
+        w[t] = load_be32(block + 4 * t);
+    }
+    for (int t = 16; t < 64; t++) {
+        uint32_t s0 = rotr32(w[t - 15], 7) ^ rotr32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+        uint32_t s1 = rotr32(w[t - 2], 17) ^ rotr32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+        w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int t = 0; t < 64; t++) {
+        uint32_t S1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + S1 + ch + K[t] + w[t];
+        uint32_t S0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = S0 + maj;
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256_state_to_digest(const uint32_t state[8], uint8_t digest[SHA256_DIGEST_SIZE]) {
+    for (int i = 0; i < 8; i++) {
+        store_be32(digest + 4 * i, state[i]);
+    }
+}
+
+// Hashes `len` bytes (a multiple of 64) once so that later hashes can start from the result
+void sha256_midstate(Sha256Midstate* ms, const uint8_t* prefix, size_t len) {
+    sha256_init_state(ms->h);
+    for (size_t off = 0; off + SHA256_BLOCK_SIZE <= len; off += SHA256_BLOCK_SIZE) {
+        sha256_compress(ms->h, prefix + off);
+    }
+    ms->prefix_len = len & ~(uint64_t)(SHA256_BLOCK_SIZE - 1);
+}
+
+size_t sha256_padded_len(size_t len) {
+    // 1 byte 0x80 + 8 bytes de comprimento, arredondado a 64
+    return (len + 9 + SHA256_BLOCK_SIZE - 1) & ~(size_t)(SHA256_BLOCK_SIZE - 1);
+}
+
+// Writes the SHA-256 padding after `len` bytes of message; buf must hold sha256_padded_len(len) bytes
+void sha256_pad(uint8_t* buf, size_t len) {
+    size_t padded = sha256_padded_len(len);
+    uint64_t bits = (uint64_t)len * 8;
+
+    buf[len] = 0x80;
+    memset(buf + len + 1, 0, padded - len - 1 - 8);
+    for (int i = 0; i < 8; i++) {
+        buf[padded - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+void sha256(const void* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t state[8];
+    uint8_t tail[2 * SHA256_BLOCK_SIZE];
+
+    sha256_init_state(state);
+
+    size_t full = len & ~(size_t)(SHA256_BLOCK_SIZE - 1);
+    for (size_t off = 0; off < full; off += SHA256_BLOCK_SIZE) {
+        sha256_compress(state, p + off);
+    }
+
+    // O campo de comprimento do padding conta a mensagem inteira, não só a cauda
+    size_t rem = len - full;
+    size_t tail_len = sha256_padded_len(rem);
+    uint64_t bits = (uint64_t)len * 8;
+    memcpy(tail, p + full, rem);
+    tail[rem] = 0x80;
+    memset(tail + rem + 1, 0, tail_len - rem - 1 - 8);
+    for (int i = 0; i < 8; i++) {
+        tail[tail_len - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    for (size_t off = 0; off < tail_len; off += SHA256_BLOCK_SIZE) {
+        sha256_compress(state, tail + off);
+    }
+
+    sha256_state_to_digest(state, digest);
+}
+
+void sha256_digest_to_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char* hex) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        hex[2 * i]     = digits[digest[i] >> 4];
+        hex[2 * i + 1] = digits[digest[i] & 0x0f];
+    }
+    hex[2 * SHA256_DIGEST_SIZE] = '\0';
+}
+
+#ifdef SHA256_HAVE_X86
+
+// ---------------------------------------------------------------------------
+// SSE4.1 kernel: 4 independent messages, one 32-bit lane each
+// ---------------------------------------------------------------------------
+
+#define ROTR4(x, n) _mm_or_si128(_mm_srli_epi32((x), (n)), _mm_slli_epi32((x), 32 - (n)))
+#define XOR4(a, b, c) _mm_xor_si128(_mm_xor_si128((a), (b)), (c))
+
+__attribute__((target("sse4.1")))
+static void sha256_compress_x4_sse41(uint32_t states[][8], const uint8_t* const blocks[]) {
+    __m128i w[16];
+    __m128i s[8];
+
+    for (int j = 0; j < 8; j++) {
+        s[j] = _mm_set_epi32((int)states[3][j], (int)states[2][j], (int)states[1][j], (int)states[0][j]);
+    }
+    for (int t = 0; t < 16; t++) {
+        w[t] = _mm_set_epi32((int)load_be32(blocks[3] + 4 * t), (int)load_be32(blocks[2] + 4 * t),
+                             (int)load_be32(blocks[1] + 4 * t), (int)load_be32(blocks[0] + 4 * t));
+    }
+
+    __m128i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m128i e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int t = 0; t < 64; t++) {
+        __m128i wt;
+        if (t < 16) {
+            wt = w[t];
+        } else {
+            __m128i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+            __m128i s0 = XOR4(ROTR4(w15, 7), ROTR4(w15, 18), _mm_srli_epi32(w15, 3));
+            __m128i s1 = XOR4(ROTR4(w2, 17), ROTR4(w2, 19), _mm_srli_epi32(w2, 10));
+            wt = _mm_add_epi32(_mm_add_epi32(w[t & 15], s0), _mm_add_epi32(w[(t - 7) & 15], s1));
+            w[t & 15] = wt;
+        }
+
+        __m128i S1 = XOR4(ROTR4(e, 6), ROTR4(e, 11), ROTR4(e, 25));
+        __m128i ch = _mm_xor_si128(_mm_and_si128(e, f), _mm_andnot_si128(e, g));
+        __m128i t1 = _mm_add_epi32(_mm_add_epi32(h, S1),
+                                   _mm_add_epi32(_mm_add_epi32(ch, _mm_set1_epi32((int)K[t])), wt));
+        __m128i S0 = XOR4(ROTR4(a, 2), ROTR4(a, 13), ROTR4(a, 22));
+        __m128i maj = _mm_or_si128(_mm_and_si128(a, b), _mm_and_si128(c, _mm_or_si128(a, b)));
+        __m128i t2 = _mm_add_epi32(S0, maj);
+
+        h = g; g = f; f = e; e = _mm_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm_add_epi32(t1, t2);
+    }
+
+    s[0] = _mm_add_epi32(s[0], a); s[1] = _mm_add_epi32(s[1], b);
+    s[2] = _mm_add_epi32(s[2], c); s[3] = _mm_add_epi32(s[3], d);
+    s[4] = _mm_add_epi32(s[4], e); s[5] = _mm_add_epi32(s[5], f);
+    s[6] = _mm_add_epi32(s[6], g); s[7] = _mm_add_epi32(s[7], h);
+
+    for (int j = 0; j < 8; j++) {
+        uint32_t out[4];
+        _mm_storeu_si128((__m128i*)out, s[j]);
+        for (int l = 0; l < 4; l++) {
+            states[l][j] = out[l];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 kernel: 8 independent messages, one 32-bit lane each
+// ---------------------------------------------------------------------------
+
+#define ROTR8(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+#define XOR8(a, b, c) _mm256_xor_si256(_mm256_xor_si256((a), (b)), (c))
+
+__attribute__((target("avx2")))
+static void sha256_compress_x8_avx2(uint32_t states[][8], const uint8_t* const blocks[]) {
+    __m256i w[16];
+    __m256i s[8];
+
+    for (int j = 0; j < 8; j++) {
+        s[j] = _mm256_set_epi32((int)states[7][j], (int)states[6][j], (int)states[5][j], (int)states[4][j],
+                                (int)states[3][j], (int)states[2][j], (int)states[1][j], (int)states[0][j]);
+    }
+    for (int t = 0; t < 16; t++) {
+        w[t] = _mm256_set_epi32((int)load_be32(blocks[7] + 4 * t), (int)load_be32(blocks[6] + 4 * t),
+                                (int)load_be32(blocks[5] + 4 * t), (int)load_be32(blocks[4] + 4 * t),
+                                (int)load_be32(blocks[3] + 4 * t), (int)load_be32(blocks[2] + 4 * t),
+                                (int)load_be32(blocks[1] + 4 * t), (int)load_be32(blocks[0] + 4 * t));
+    }
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int t = 0; t < 64; t++) {
+        __m256i wt;
+        if (t < 16) {
+            wt = w[t];
+        } else {
+            __m256i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+            __m256i s0 = XOR8(ROTR8(w15, 7), ROTR8(w15, 18), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = XOR8(ROTR8(w2, 17), ROTR8(w2, 19), _mm256_srli_epi32(w2, 10));
+            wt = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+            w[t & 15] = wt;
+        }
+
+        __m256i S1 = XOR8(ROTR8(e, 6), ROTR8(e, 11), ROTR8(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1),
+                                      _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32((int)K[t])), wt));
+        __m256i S0 = XOR8(ROTR8(a, 2), ROTR8(a, 13), ROTR8(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(S0, maj);
+
+        h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+    }
+
+    s[0] = _mm256_add_epi32(s[0], a); s[1] = _mm256_add_epi32(s[1], b);
+    s[2] = _mm256_add_epi32(s[2], c); s[3] = _mm256_add_epi32(s[3], d);
+    s[4] = _mm256_add_epi32(s[4], e); s[5] = _mm256_add_epi32(s[5], f);
+    s[6] = _mm256_add_epi32(s[6], g); s[7] = _mm256_add_epi32(s[7], h);
+
+    for (int j = 0; j < 8; j++) {
+        uint32_t out[8];
+        _mm256_storeu_si256((__m256i*)out, s[j]);
+        for (int l = 0; l < 8; l++) {
+            states[l][j] = out[l];
+        }
+    }
+}
+
+#endif // SHA256_HAVE_X86
+
+// ---------------------------------------------------------------------------
+// Runtime dispatch
+// ---------------------------------------------------------------------------
+
+static int impl_selected = 0;
+static Sha256Impl active_impl = SHA256_IMPL_SCALAR;
+
+Sha256Impl sha256_detect_impl(void) {
+#ifdef SHA256_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SHA256_IMPL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SHA256_IMPL_SSE41;
+    }
+#endif
+    return SHA256_IMPL_SCALAR;
+}
+
+Sha256Impl sha256_get_impl(void) {
+    if (!impl_selected) {
+        active_impl = sha256_detect_impl();
+        impl_selected = 1;
+    }
+    return active_impl;
+}
+
+void sha256_set_impl(Sha256Impl impl) {
+    if (impl <= sha256_detect_impl()) {
+        active_impl = impl;
+        impl_selected = 1;
+    }
+}
+
+int sha256_impl_lanes(Sha256Impl impl) {
+    switch (impl) {
+        case SHA256_IMPL_AVX2:  return 8;
+        case SHA256_IMPL_SSE41: return 4;
+        default:                return 1;
+    }
+}
+
+const char* sha256_impl_name(Sha256Impl impl) {
+    switch (impl) {
+        case SHA256_IMPL_AVX2:  return "avx2-x8";
+        case SHA256_IMPL_SSE41: return "sse4.1-x4";
+        default:                return "scalar";
+    }
+}
+
+void sha256_compress_multi(uint32_t states[][8], const uint8_t* const blocks[], int lanes) {
+    Sha256Impl impl = sha256_get_impl();
+    int i = 0;
+
+#ifdef SHA256_HAVE_X86
+    if (impl == SHA256_IMPL_AVX2) {
+        for (; i + 8 <= lanes; i += 8) {
+            sha256_compress_x8_avx2(states + i, blocks + i);
+        }
+    }
+    if (impl >= SHA256_IMPL_SSE41) {
+        for (; i + 4 <= lanes; i += 4) {
+            sha256_compress_x4_sse41(states + i, blocks + i);
+        }
+    }
+#else
+    (void)impl;
+#endif
+
+    for (; i < lanes; i++) {
+        sha256_compress(states[i], blocks[i]);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_MAX_LANES 8   // Largura máxima do kernel multi-buffer (AVX2)
+
+// Implementações disponíveis do kernel de compressão
+typedef enum {
+    SHA256_IMPL_SCALAR = 0,
+    SHA256_IMPL_SSE41,      // 4 lanes por chamada
+    SHA256_IMPL_AVX2        // 8 lanes por chamada
+} Sha256Impl;
+
+// Scalar API
+void sha256_init_state(uint32_t state[8]);
+void sha256_compress(uint32_t state[8], const uint8_t block[SHA256_BLOCK_SIZE]);
+void sha256_state_to_digest(const uint32_t state[8], uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256(const void* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256_digest_to_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char* hex); // hex: 65 bytes
+
+// Midstate: state after compressing a prefix made of whole 64-byte blocks.
+// Messages sharing that prefix only pay for the blocks that follow it.
+typedef struct {
+    uint32_t h[8];
+    uint64_t prefix_len;   // Bytes already absorbed (multiple of 64)
+} Sha256Midstate;
+
+void sha256_midstate(Sha256Midstate* ms, const uint8_t* prefix, size_t len);
+
+// Padded message length (multiple of 64) and in-place padding of a message
+size_t sha256_padded_len(size_t len);
+void sha256_pad(uint8_t* buf, size_t len);
+
+// Multi-buffer API: compresses one block into each of `lanes` independent states.
+// Uses the widest kernel selected at runtime and falls back to scalar for the tail.
+void sha256_compress_multi(uint32_t states[][8], const uint8_t* const blocks[], int lanes);
+
+// Runtime dispatch
+Sha256Impl sha256_detect_impl(void);
+Sha256Impl sha256_get_impl(void);
+void sha256_set_impl(Sha256Impl impl);   // ignored if the CPU does not support it
+int sha256_impl_lanes(Sha256Impl impl);
+const char* sha256_impl_name(Sha256Impl impl);
+
+#endif
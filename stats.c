@@ -0,0 +1,275 @@
+#include "stats.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+StatsShm* stats_ptr = NULL;
+_Thread_local StatsCounters* stats_slot = NULL;
+
+static volatile sig_atomic_t running_statistics = 1;
+static volatile sig_atomic_t latency_requested = 0;
+
+static const char* latency_stage_names[LAT_STAGE_COUNT] = {
+    [LAT_POOL_WAIT] = "pool wait",
+    [LAT_ASSEMBLY] = "assembly",
+    [LAT_POW] = "pow",
+    [LAT_VALIDATION] = "validation",
+    [LAT_COMMIT] = "commit",
+    [LAT_END_TO_END] = "end-to-end",
+};
+
+// No filho de um fork o slot herdado pertence ao pai
+static void stats_after_fork(void) {
+    stats_slot = NULL;
+}
+
+StatsShm* create_stats_memory(void) {
+    int fd = shm_open(STATS_SHM, O_CREAT | O_RDWR, 0666);
+    if (fd == -1 || ftruncate(fd, sizeof(StatsShm)) == -1) {
+        LOG_ERROR(LOG_CAT_STATS, "ERROR: Failed to create %s", STATS_SHM);
+        exit(EXIT_FAILURE);
+    }
+
+    stats_ptr = mmap(NULL, sizeof(StatsShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (stats_ptr == MAP_FAILED) {
+        LOG_ERROR(LOG_CAT_STATS, "ERROR: mmap failed for %s", STATS_SHM);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(stats_ptr, 0, sizeof(StatsShm));
+    pthread_atfork(NULL, NULL, stats_after_fork);
+    LOG_INFO(LOG_CAT_SHM, "SHM: %s created and mapped (%zu bytes)", STATS_SHM, sizeof(StatsShm));
+    return stats_ptr;
+}
+
+void open_stats_memory(void) {
+    int fd = shm_open(STATS_SHM, O_RDWR, 0666);
+    if (fd == -1) {
+        return;
+    }
+
+    StatsShm* shm = mmap(NULL, sizeof(StatsShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        return;
+    }
+    pthread_atfork(NULL, NULL, stats_after_fork);
+    stats_ptr = shm;
+}
+
+void close_stats_memory(int unlink_segment) {
+    if (stats_ptr != NULL) {
+        munmap(stats_ptr, sizeof(StatsShm));
+        stats_ptr = NULL;
+    }
+    if (unlink_segment) {
+        shm_unlink(STATS_SHM);
+    }
+}
+
+// First counter update of a thread: take a free slot, or share slot 0 when all are taken
+StatsCounters* stats_claim_slot(void) {
+    uint32_t pid = (uint32_t)getpid();
+
+    for (int i = 1; i < STATS_MAX_WRITERS; i++) {
+        uint32_t expected = 0;
+        if (atomic_compare_exchange_strong(&stats_ptr->writers[i].owner, &expected, pid)) {
+            stats_slot = &stats_ptr->writers[i];
+            return stats_slot;
+        }
+    }
+    stats_slot = &stats_ptr->writers[0];
+    return stats_slot;
+}
+
+void stats_collect(StatsTotals* totals) {
+    memset(totals, 0, sizeof(*totals));
+    for (int i = 0; i < STATS_MAX_WRITERS; i++) {
+        StatsCounters* c = &stats_ptr->writers[i];
+        totals->tx_inserted += atomic_load_explicit(&c->tx_inserted, memory_order_relaxed);
+        totals->blocks_mined += atomic_load_explicit(&c->blocks_mined, memory_order_relaxed);
+        totals->blocks_validated += atomic_load_explicit(&c->blocks_validated, memory_order_relaxed);
+        totals->blocks_rejected += atomic_load_explicit(&c->blocks_rejected, memory_order_relaxed);
+        totals->hashes += atomic_load_explicit(&c->hashes, memory_order_relaxed);
+        totals->pool_full_ns += atomic_load_explicit(&c->pool_full_ns, memory_order_relaxed);
+    }
+}
+
+// Slots de processos que terminaram ficam livres; os contadores mantêm-se (são totais)
+static void reclaim_slots(void) {
+    for (int i = 1; i < STATS_MAX_WRITERS; i++) {
+        uint32_t owner = atomic_load(&stats_ptr->writers[i].owner);
+        if (owner != 0 && kill((pid_t)owner, 0) == -1 && errno == ESRCH) {
+            atomic_compare_exchange_strong(&stats_ptr->writers[i].owner, &owner, 0);
+        }
+    }
+}
+
+uint64_t stats_latency_percentile(const uint64_t* buckets, uint64_t count, double q) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen > rank) {
+            return latency_bucket_high(b);
+        }
+    }
+    return latency_bucket_high(LATENCY_BUCKETS - 1);
+}
+
+// Escolhe a unidade para que o número fique legível (ns .. s)
+static const char* format_ns(uint64_t ns, char* buf, size_t len) {
+    if (ns < 1000) {
+        snprintf(buf, len, "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, len, "%.1fus", ns / 1e3);
+    } else if (ns < 1000000000) {
+        snprintf(buf, len, "%.2fms", ns / 1e6);
+    } else {
+        snprintf(buf, len, "%.3fs", ns / 1e9);
+    }
+    return buf;
+}
+
+static void report_latency(void) {
+    static uint64_t buckets[LATENCY_BUCKETS];
+
+    for (int stage = 0; stage < LAT_STAGE_COUNT; stage++) {
+        LatencyHistogram* h = &stats_ptr->latency[stage];
+        uint64_t count = 0;
+
+        // Cópia dos buckets: os percentis saem de um retrato coerente com a própria contagem
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            buckets[b] = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+            count += buckets[b];
+        }
+        if (count == 0) {
+            LOG_INFO(LOG_CAT_STATS, "STATS: latency %-10s no samples", latency_stage_names[stage]);
+            continue;
+        }
+
+        // O topo de um bucket pode passar o máximo real; nenhum percentil o ultrapassa
+        uint64_t max_ns = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+        uint64_t q[3] = {stats_latency_percentile(buckets, count, 0.50),
+                         stats_latency_percentile(buckets, count, 0.99),
+                         stats_latency_percentile(buckets, count, 0.999)};
+        for (int i = 0; i < 3; i++) {
+            if (q[i] > max_ns) {
+                q[i] = max_ns;
+            }
+        }
+
+        char p50[16], p99[16], p999[16], max[16], mean[16];
+        uint64_t sum = atomic_load_explicit(&h->sum_ns, memory_order_relaxed);
+        LOG_INFO(LOG_CAT_STATS, "STATS: latency %-10s n=%llu mean %s p50 %s p99 %s p999 %s max %s",
+                 latency_stage_names[stage], (unsigned long long)count,
+                 format_ns(sum / count, mean, sizeof(mean)),
+                 format_ns(q[0], p50, sizeof(p50)), format_ns(q[1], p99, sizeof(p99)),
+                 format_ns(q[2], p999, sizeof(p999)), format_ns(max_ns, max, sizeof(max)));
+    }
+}
+
+static double elapsed_seconds(const struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - since->tv_sec) + (double)(now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+static void report_rates(const StatsTotals* now, const StatsTotals* before, double seconds) {
+    if (seconds <= 0) {
+        return;
+    }
+    LOG_INFO(LOG_CAT_STATS, "STATS: %.1f tx/s inserted | %.2f blocks/s mined | %.2f validated/s | "
+             "%.2f rejected/s | %.2f MH/s | pool full %.1f ms/s",
+             (now->tx_inserted - before->tx_inserted) / seconds,
+             (now->blocks_mined - before->blocks_mined) / seconds,
+             (now->blocks_validated - before->blocks_validated) / seconds,
+             (now->blocks_rejected - before->blocks_rejected) / seconds,
+             (now->hashes - before->hashes) / seconds / 1e6,
+             (now->pool_full_ns - before->pool_full_ns) / seconds / 1e6);
+}
+
+static void report_summary(const StatsTotals* totals, double seconds) {
+    uint64_t blocks = totals->blocks_validated + totals->blocks_rejected;
+
+    LOG_INFO(LOG_CAT_STATS, "STATS: ===== Final summary (%.1f s) =====", seconds);
+    LOG_INFO(LOG_CAT_STATS, "STATS: Transactions inserted: %llu (%.1f tx/s)",
+             (unsigned long long)totals->tx_inserted, seconds > 0 ? totals->tx_inserted / seconds : 0.0);
+    LOG_INFO(LOG_CAT_STATS, "STATS: Blocks mined: %llu, validated: %llu, rejected: %llu (%.1f%% rejected)",
+             (unsigned long long)totals->blocks_mined, (unsigned long long)totals->blocks_validated,
+             (unsigned long long)totals->blocks_rejected,
+             blocks > 0 ? 100.0 * totals->blocks_rejected / blocks : 0.0);
+    LOG_INFO(LOG_CAT_STATS, "STATS: Hashes computed: %llu (%.2f MH/s average)",
+             (unsigned long long)totals->hashes, seconds > 0 ? totals->hashes / seconds / 1e6 : 0.0);
+    LOG_INFO(LOG_CAT_STATS, "STATS: Pool-full wait: %.3f s total", totals->pool_full_ns / 1e9);
+    report_latency();
+}
+
+void handle_sigint_statistics(int sig) {
+    (void)sig;
+    running_statistics = 0;
+}
+
+void handle_sigusr1_statistics(int sig) {
+    (void)sig;
+    latency_requested = 1;
+}
+
+// Statistics process: aggregates every writer slot into periodic rate reports, prints
+// the latency percentiles on SIGUSR1 and a final summary when the controller forwards SIGINT.
+// SIGUSR1 replaces the inherited log-level handler here; levels are still changed through
+// the controller's pid.
+void run_statistics_process(Config* config) {
+    signal(SIGINT, handle_sigint_statistics);
+    signal(SIGUSR1, handle_sigusr1_statistics);
+
+    int interval = config->stats_interval;
+    struct timespec start, last;
+    StatsTotals previous, current;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    last = start;
+    stats_collect(&previous);
+    LOG_INFO(LOG_CAT_STATS, "STATS: Statistics process started (report every %d s, kill -USR1 %d for latency)",
+             interval, getpid());
+
+    unsigned int remaining = (unsigned int)interval;
+    while (running_statistics) {
+        remaining = sleep(remaining);    // Interrompido pelo SIGINT/SIGUSR1: devolve o que faltava
+        if (!running_statistics) {
+            break;
+        }
+        if (latency_requested) {
+            latency_requested = 0;
+            report_latency();
+        }
+        if (remaining > 0) {
+            continue;
+        }
+        remaining = (unsigned int)interval;
+
+        stats_collect(&current);
+        report_rates(&current, &previous, elapsed_seconds(&last));
+        clock_gettime(CLOCK_MONOTONIC, &last);
+        previous = current;
+        reclaim_slots();
+    }
+
+    stats_collect(&current);
+    report_summary(&current, elapsed_seconds(&start));
+}
@@ -0,0 +1,129 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "common.h"
+
+#define STATS_SHM "/stats_shm"
+#define STATS_MAX_WRITERS 64          // Slot 0 é partilhado pelas threads que não têm slot próprio
+#define STATS_DEFAULT_INTERVAL 5      // Segundos entre relatórios
+
+// Counters of one writer thread, alone in its cache line so that increments never
+// bounce lines between cores. Writers only do relaxed fetch_add on their own slot.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tx_inserted;
+    _Atomic uint64_t blocks_mined;
+    _Atomic uint64_t blocks_validated;
+    _Atomic uint64_t blocks_rejected;
+    _Atomic uint64_t hashes;
+    _Atomic uint64_t pool_full_ns;    // Tempo dos txgen à espera de slots livres (pool cheia)
+    _Atomic uint32_t owner;           // pid do dono, 0 = livre
+} StatsCounters;
+
+// Estágios com histograma de latência
+typedef enum {
+    LAT_POOL_WAIT = 0,   // Criação da transação -> reserva por um miner para um bloco completo
+    LAT_ASSEMBLY,        // Miner acordado pelo futex -> bloco pronto para o PoW
+    LAT_POW,             // Pesquisa do nonce pela equipa
+    LAT_VALIDATION,      // Publicação no ring -> veredicto do validator (inclui a fila)
+    LAT_COMMIT,          // Escrita na blockchain e remoção das transações da pool
+    LAT_END_TO_END,      // Criação da transação -> commit
+    LAT_STAGE_COUNT
+} LatencyStage;
+
+// HDR-style histogram: values below 2^LATENCY_SUB_BITS ns are exact, above that every
+// power of two is split into LATENCY_SUB_BUCKETS linear buckets, so any recorded value
+// is known to within 1/16 (~6%) over the whole 1 ns .. 584 years range.
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t count;
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+typedef struct {
+    StatsCounters writers[STATS_MAX_WRITERS];
+    LatencyHistogram latency[LAT_STAGE_COUNT];
+} StatsShm;
+
+// Soma de todos os slots, lida pelo processo Statistics
+typedef struct {
+    uint64_t tx_inserted;
+    uint64_t blocks_mined;
+    uint64_t blocks_validated;
+    uint64_t blocks_rejected;
+    uint64_t hashes;
+    uint64_t pool_full_ns;
+} StatsTotals;
+
+extern StatsShm* stats_ptr;
+
+StatsShm* create_stats_memory(void);    // Controller, antes dos fork()
+void open_stats_memory(void);           // txgen; sem o segmento as estatísticas ficam desligadas
+void close_stats_memory(int unlink_segment);
+
+extern _Thread_local StatsCounters* stats_slot;
+StatsCounters* stats_claim_slot(void);
+
+static inline StatsCounters* stats_thread_slot(void) {
+    return stats_slot != NULL ? stats_slot : stats_claim_slot();
+}
+
+void stats_collect(StatsTotals* totals);
+void run_statistics_process(Config* config);   // SIGUSR1 no processo Statistics: percentis de latência
+
+static inline int latency_bucket(uint64_t ns) {
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return (int)ns;
+    }
+    int shift = 63 - __builtin_clzll(ns) - LATENCY_SUB_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (int)(ns >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+// Maior valor que cai no mesmo bucket (o que o HDR reporta como percentil)
+static inline uint64_t latency_bucket_high(int bucket) {
+    if (bucket < 2 * LATENCY_SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t mantissa = (uint64_t)(bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+static inline void stats_record_latency(LatencyStage stage, uint64_t ns) {
+    LatencyHistogram* h = &stats_ptr->latency[stage];
+    atomic_fetch_add_explicit(&h->buckets[latency_bucket(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&h->max_ns, &max, ns,
+                                                              memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Percentil q (0..1) sobre uma cópia dos buckets
+uint64_t stats_latency_percentile(const uint64_t* buckets, uint64_t count, double q);
+
+// Contador da thread atual; não faz nada se o segmento não estiver mapeado
+#define STATS_ADD(field, n) \
+    do { \
+        if (stats_ptr != NULL) { \
+            atomic_fetch_add_explicit(&stats_thread_slot()->field, (uint64_t)(n), memory_order_relaxed); \
+        } \
+    } while (0)
+
+// Latência de um estágio entre dois instantes CLOCK_MONOTONIC (ns); ignora inícios por preencher
+#define STATS_LATENCY(stage, start_ns, end_ns) \
+    do { \
+        if (stats_ptr != NULL && (start_ns) != 0 && (end_ns) >= (start_ns)) { \
+            stats_record_latency((stage), (end_ns) - (start_ns)); \
+        } \
+    } while (0)
+
+#endif
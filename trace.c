@@ -0,0 +1,154 @@
+#include "trace.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define TRACE_BUFFER_RECORDS 1024
+
+typedef struct {
+    uint32_t pid;
+    uint32_t tid;
+    int count;
+    TraceRecord records[TRACE_BUFFER_RECORDS];
+} TraceBuffer;
+
+int trace_enabled = 0;
+
+static int trace_fd = -1;
+static _Thread_local TraceBuffer* thread_buffer = NULL;
+static pthread_key_t buffer_key;
+static pthread_once_t buffer_key_once = PTHREAD_ONCE_INIT;
+
+static const char* event_names[TRACE_EVENT_COUNT] = {
+    [TRACE_TX_INSERT] = "TX_INSERT",
+    [TRACE_TX_CLAIM] = "TX_CLAIM",
+    [TRACE_TX_RELEASE] = "TX_RELEASE",
+    [TRACE_TX_COMMIT] = "TX_COMMIT",
+    [TRACE_BLOCK_MINED] = "BLOCK_MINED",
+    [TRACE_BLOCK_PUBLISH] = "BLOCK_PUBLISH",
+    [TRACE_BLOCK_COMMIT] = "BLOCK_COMMIT",
+    [TRACE_BLOCK_REJECT] = "BLOCK_REJECT",
+};
+
+const char* trace_event_name(int event) {
+    if (event <= 0 || event >= TRACE_EVENT_COUNT || event_names[event] == NULL) {
+        return "UNKNOWN";
+    }
+    return event_names[event];
+}
+
+// txb_id = "pid-miner-seq"
+uint32_t trace_block_seq(const char* txb_id) {
+    const char* dash = strrchr(txb_id, '-');
+    return (uint32_t)strtoul(dash != NULL ? dash + 1 : txb_id, NULL, 10);
+}
+
+// O_APPEND: cada write() de um buffer fica inteiro no fim do ficheiro, mesmo com vários processos
+static void buffer_write(TraceBuffer* buf) {
+    if (buf->count > 0 && trace_fd != -1) {
+        ssize_t len = (ssize_t)(sizeof(TraceRecord) * (size_t)buf->count);
+        if (write(trace_fd, buf->records, (size_t)len) != len) {
+            LOG_ERROR(LOG_CAT_GENERAL, "ERROR: Failed to write %d trace records", buf->count);
+        }
+    }
+    buf->count = 0;
+}
+
+static void buffer_destroy(void* ptr) {
+    TraceBuffer* buf = ptr;
+    buffer_write(buf);
+    free(buf);
+}
+
+static void buffer_key_create(void) {
+    pthread_key_create(&buffer_key, buffer_destroy);
+}
+
+// O filho de um fork herda uma cópia do buffer do pai: descarta-a para não a escrever duas vezes
+static void trace_after_fork(void) {
+    if (thread_buffer != NULL) {
+        thread_buffer->count = 0;
+        thread_buffer->pid = (uint32_t)getpid();
+        thread_buffer->tid = (uint32_t)syscall(SYS_gettid);
+    }
+}
+
+static TraceBuffer* buffer_for_thread(void) {
+    if (thread_buffer == NULL) {
+        TraceBuffer* buf = malloc(sizeof(TraceBuffer));
+        if (buf == NULL) {
+            return NULL;
+        }
+        buf->pid = (uint32_t)getpid();
+        buf->tid = (uint32_t)syscall(SYS_gettid);
+        buf->count = 0;
+
+        pthread_once(&buffer_key_once, buffer_key_create);
+        pthread_setspecific(buffer_key, buf);
+        thread_buffer = buf;
+    }
+    return thread_buffer;
+}
+
+void trace_record(const TraceRecord* rec) {
+    TraceBuffer* buf = buffer_for_thread();
+    if (buf == NULL) {
+        return;
+    }
+
+    TraceRecord* slot = &buf->records[buf->count++];
+    memcpy(slot, rec, sizeof(TraceRecord));
+    slot->pid = buf->pid;
+    slot->tid = buf->tid;
+
+    if (buf->count == TRACE_BUFFER_RECORDS) {
+        buffer_write(buf);
+    }
+}
+
+void trace_flush(void) {
+    if (thread_buffer != NULL) {
+        buffer_write(thread_buffer);
+    }
+}
+
+int trace_open(const char* path, int truncate) {
+    int flags = O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0);
+    trace_fd = open(path, flags, 0644);
+    if (trace_fd == -1) {
+        LOG_ERROR(LOG_CAT_GENERAL, "ERROR: Failed to open trace file %s", path);
+        return -1;
+    }
+
+    // Quem encontra o ficheiro vazio escreve o cabeçalho
+    struct stat st;
+    if (fstat(trace_fd, &st) == 0 && st.st_size == 0) {
+        TraceFileHeader header = {0};
+        memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.version = TRACE_VERSION;
+        header.record_size = sizeof(TraceRecord);
+        if (write(trace_fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+            LOG_ERROR(LOG_CAT_GENERAL, "ERROR: Failed to write trace header to %s", path);
+        }
+    }
+
+    pthread_atfork(NULL, NULL, trace_after_fork);
+    atexit(trace_flush);    // exit() corre na thread principal de cada processo
+    trace_enabled = 1;
+    LOG_INFO(LOG_CAT_GENERAL, "INFO: Binary trace enabled (%s)", path);
+    return 0;
+}
+
+void trace_close(void) {
+    trace_flush();
+    trace_enabled = 0;
+    if (trace_fd != -1) {
+        close(trace_fd);
+        trace_fd = -1;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define TRACE_FILE "DEIChain_trace.bin"
+#define TRACE_MAGIC "DEITRACE"
+#define TRACE_VERSION 1
+
+// Eventos registados no trace binário
+typedef enum {
+    TRACE_TX_INSERT = 1,     // txgen: tx_id, slot, aux = reward
+    TRACE_TX_CLAIM,          // miner: tx_id, slot
+    TRACE_TX_RELEASE,        // miner/validator: tx_id, slot
+    TRACE_TX_COMMIT,         // validator: tx_id, slot
+    TRACE_BLOCK_MINED,       // miner: block_seq, nonce, aux = transações
+    TRACE_BLOCK_PUBLISH,     // miner: block_seq
+    TRACE_BLOCK_COMMIT,      // validator: block_seq, nonce, aux = altura
+    TRACE_BLOCK_REJECT,      // validator: block_seq
+    TRACE_EVENT_COUNT
+} TraceEvent;
+
+// Cabeçalho do ficheiro, escrito uma vez por quem o cria
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} TraceFileHeader;
+
+// Fixed-size record. Timestamps are CLOCK_MONOTONIC nanoseconds, so records written
+// by different processes on the same machine can be merged by time.
+typedef struct {
+    uint64_t ts_ns;
+    uint16_t event;
+    int16_t miner_id;        // -1 quando não se aplica
+    uint32_t pid;
+    uint32_t tid;
+    int32_t tx_id;
+    int32_t slot;
+    uint32_t nonce;
+    uint32_t block_seq;      // Terceiro campo de txb_id ("pid-miner-seq")
+    int32_t aux;
+} TraceRecord;
+
+// Buffer por thread: o caminho quente só copia o registo; o write() acontece quando o
+// buffer enche, no fim da thread e no exit() do processo.
+extern int trace_enabled;
+
+int trace_open(const char* path, int truncate);   // Controller cria (truncate = 1); txgen acrescenta
+void trace_record(const TraceRecord* rec);
+void trace_flush(void);
+void trace_close(void);
+
+uint32_t trace_block_seq(const char* txb_id);
+const char* trace_event_name(int event);
+
+static inline uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Hot-path helpers: nothing but a flag test when tracing is off
+static inline void trace_tx(TraceEvent event, int tx_id, int slot, int miner_id, int aux) {
+    if (trace_enabled) {
+        TraceRecord rec = {
+            .ts_ns = trace_now_ns(), .event = (uint16_t)event, .miner_id = (int16_t)miner_id,
+            .tx_id = tx_id, .slot = slot, .aux = aux,
+        };
+        trace_record(&rec);
+    }
+}
+
+static inline void trace_block(TraceEvent event, const char* txb_id, int miner_id, uint32_t nonce, int aux) {
+    if (trace_enabled) {
+        TraceRecord rec = {
+            .ts_ns = trace_now_ns(), .event = (uint16_t)event, .miner_id = (int16_t)miner_id,
+            .tx_id = -1, .slot = -1, .nonce = nonce, .block_seq = trace_block_seq(txb_id), .aux = aux,
+        };
+        trace_record(&rec);
+    }
+}
+
+#endif
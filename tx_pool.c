@@ -0,0 +1,772 @@
+#include "tx_pool.h"
+#include "futex.h"
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#define FREE_PACK(tag, slot1) (((uint64_t)(tag) << 32) | (uint32_t)(slot1))
+#define FREE_TAG(head) ((uint32_t)((head) >> 32))
+#define FREE_SLOT1(head) ((uint32_t)(head))      // slot + 1; 0 = pilha vazia
+
+// Célula do índice id -> slot: (id << 32) | (slot + 1); 0 = nunca usada
+#define INDEX_PACK(id, slot) (((uint64_t)(uint32_t)(id) << 32) | (uint32_t)((slot) + 1))
+#define INDEX_ID(cell) ((uint32_t)((cell) >> 32))
+#define INDEX_SLOT1(cell) ((uint32_t)(cell))
+#define INDEX_EMPTY 0ull
+#define INDEX_TOMBSTONE 0xffffffffull           // Entrada removida; a sondagem continua
+#define INDEX_FENCE 0xfffffffeull               // Vazia, reservada por quem limpa tombstones
+
+// Célula da fila de um bucket de reward
+typedef struct {
+    _Atomic uint64_t seq;
+    uint32_t slot;
+} TxBucketCell;
+
+static inline _Atomic uint64_t* slot_states(TransactionPool* pool) {
+    return (_Atomic uint64_t*)((char*)pool + pool->slot_state_offset);
+}
+
+static inline _Atomic uint32_t* free_next(TransactionPool* pool) {
+    return (_Atomic uint32_t*)((char*)pool + pool->free_next_offset);
+}
+
+static inline _Atomic uint64_t* ready_bitmap(TransactionPool* pool) {
+    return (_Atomic uint64_t*)((char*)pool + pool->ready_bitmap_offset);
+}
+
+static inline _Atomic uint64_t* occupancy_bitmap(TransactionPool* pool) {
+    return (_Atomic uint64_t*)((char*)pool + pool->transactions_pending_set.occupancy_offset);
+}
+
+static inline int32_t* pending_ids(TransactionPool* pool) {
+    return (int32_t*)((char*)pool + pool->transactions_pending_set.id_offset);
+}
+
+static inline uint8_t* pending_rewards(TransactionPool* pool) {
+    return (uint8_t*)((char*)pool + pool->transactions_pending_set.reward_offset);
+}
+
+static inline int32_t* pending_ages(TransactionPool* pool) {
+    return (int32_t*)((char*)pool + pool->transactions_pending_set.age_offset);
+}
+
+static inline TxPayload* pending_payload(TransactionPool* pool) {
+    return (TxPayload*)((char*)pool + pool->transactions_pending_set.payload_offset);
+}
+
+static inline int bitmap_words(int pool_size) {
+    return (pool_size + 63) / 64;
+}
+
+static inline uint64_t bucket_capacity(int pool_size) {
+    uint64_t cap = 1;
+    while (cap < (uint64_t)pool_size) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+static inline TxBucketCell* bucket_cells(TransactionPool* pool, TxRewardBucket* bucket) {
+    return (TxBucketCell*)((char*)pool + bucket->cells_offset);
+}
+
+static inline TxPoolShard* slot_shard(TransactionPool* pool, int slot) {
+    return &pool->shards[slot / pool->shard_slots];
+}
+
+static inline TxRewardBucket* reward_bucket(TxPoolShard* shard, int reward) {
+    if (reward < 1) {
+        reward = 1;
+    } else if (reward > TX_REWARD_LEVELS) {
+        reward = TX_REWARD_LEVELS;
+    }
+    return &shard->reward_buckets[reward - 1];
+}
+
+// Slots por shard. Com shards de 64 ou mais slots o tamanho é múltiplo de 64, para
+// que cada palavra do bitmap de ocupação pertença a um único shard.
+static int shard_slots(int pool_size, int shards) {
+    int per = (pool_size + shards - 1) / shards;
+    if (per >= 64) {
+        per = (per + 63) & ~63;
+    }
+    return per > 0 ? per : 1;
+}
+
+int tx_pool_shard_count(int pool_size, int requested) {
+    int shards = requested > 0 ? requested : pool_size / 64;
+    if (shards < 1) {
+        shards = 1;
+    } else if (shards > TX_POOL_MAX_SHARDS) {
+        shards = TX_POOL_MAX_SHARDS;
+    }
+    if (shards > pool_size) {
+        shards = pool_size > 0 ? pool_size : 1;
+    }
+    // O arredondamento a 64 pode deixar os últimos shards sem slots
+    int per = shard_slots(pool_size, shards);
+    shards = (pool_size + per - 1) / per;
+    return shards > 0 ? shards : 1;
+}
+
+// Pelo menos 2x pool_size células, para manter a ocupação abaixo de 50%
+static inline int id_index_bits(int pool_size) {
+    int bits = 1;
+    while ((1ull << bits) < 2ull * (uint64_t)pool_size) {
+        bits++;
+    }
+    return bits;
+}
+
+static inline _Atomic uint64_t* id_index(TransactionPool* pool) {
+    return (_Atomic uint64_t*)((char*)pool + pool->id_index_offset);
+}
+
+// Fibonacci hashing: os ids do txgen são sequenciais por processo, os bits altos do
+// produto espalham-nos pela tabela
+static inline uint64_t id_index_home(TransactionPool* pool, int tx_id) {
+    return ((uint64_t)(uint32_t)tx_id * 0x9e3779b97f4a7c15ull) >> (64 - pool->id_index_bits);
+}
+
+// Shard de um produtor: todas as transações de um sender caem no mesmo shard
+static inline int sender_shard(TransactionPool* pool, int sender_id) {
+    uint64_t h = (uint64_t)(uint32_t)sender_id * 0x9e3779b97f4a7c15ull;
+    return (int)(((h >> 32) * (uint64_t)pool->shard_count) >> 32);
+}
+
+uint32_t tx_pool_ready_count(TransactionPool* pool) {
+    // Um claim pode descontar antes de o insert somar: cada shard pode estar
+    // momentaneamente negativo, só a soma tem significado
+    int64_t total = 0;
+    for (int s = 0; s < pool->shard_count; s++) {
+        total += (int32_t)atomic_load_explicit(&pool->shards[s].ready_count, memory_order_relaxed);
+    }
+    return total > 0 ? (uint32_t)total : 0;
+}
+
+// Slots passaram a READY num shard. Só há trabalho extra se algum miner estiver a dormir:
+// nesse caso soma os shards e acorda-os quando já há um bloco completo.
+static void ready_count_add(TransactionPool* pool, TxPoolShard* shard, uint32_t n) {
+    atomic_fetch_add(&shard->ready_count, n);
+    if (atomic_load(&pool->ready_waiters) && tx_pool_ready_count(pool) >= pool->block_threshold) {
+        atomic_fetch_add(&pool->ready_seq, 1);
+        futex_wake_all(&pool->ready_seq);
+    }
+}
+
+// Relógio das reservas: CLOCK_MONOTONIC é comum a todos os processos da máquina
+static inline uint32_t lease_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec;
+}
+
+static inline size_t align_up(size_t v) {
+    return (v + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+}
+
+// Offsets dos arrays auxiliares, todos alinhados à cache line
+static void tx_pool_layout(int pool_size, int shards, TxPendingSet* pending, size_t* states, size_t* next,
+                           size_t* bitmap, size_t* buckets, size_t* index, size_t* total) {
+    size_t off = align_up(sizeof(TransactionPool));
+    pending->occupancy_offset = off;
+    off = align_up(off + sizeof(uint64_t) * (size_t)bitmap_words(pool_size));
+    pending->id_offset = off;
+    off = align_up(off + sizeof(int32_t) * (size_t)pool_size);
+    pending->reward_offset = off;
+    off = align_up(off + sizeof(uint8_t) * (size_t)pool_size);
+    pending->age_offset = off;
+    off = align_up(off + sizeof(int32_t) * (size_t)pool_size);
+    pending->payload_offset = off;
+    off = align_up(off + sizeof(TxPayload) * (size_t)pool_size);
+    *states = off;
+    off = align_up(off + sizeof(uint64_t) * (size_t)pool_size);
+    *next = off;
+    off = align_up(off + sizeof(uint32_t) * (size_t)pool_size);
+    *bitmap = off;
+    off = align_up(off + sizeof(uint64_t) * (size_t)bitmap_words(pool_size));
+    *buckets = off;   // TX_REWARD_LEVELS filas consecutivas por shard
+    off = align_up(off + sizeof(TxBucketCell) * bucket_capacity(shard_slots(pool_size, shards)) *
+                             TX_REWARD_LEVELS * (size_t)shards);
+    *index = off;
+    off = align_up(off + sizeof(uint64_t) * (1ull << id_index_bits(pool_size)));
+    *total = off;
+}
+
+size_t tx_pool_size(int pool_size, int shards) {
+    TxPendingSet pending;
+    size_t states, next, bitmap, buckets, index, total;
+    tx_pool_layout(pool_size, shards, &pending, &states, &next, &bitmap, &buckets, &index, &total);
+    return total;
+}
+
+// Open addressing with linear probing; every update is a single CAS on a 64-bit cell.
+// Invariant: between the home of a live entry and the entry itself no cell is empty.
+//
+// A removed entry becomes a tombstone, and the remover then turns the tombstones that end
+// a probe chain (the next cell is empty) back into empty cells, walking backwards. Without
+// that, insert/remove churn would eventually leave no empty cell and every miss would scan
+// the whole table. While one such tombstone is cleared, the empty cell after it is
+// fenced: inserts wait for it, lookups treat it as empty.
+static inline int index_cell_empty(uint64_t cell) {
+    return cell == INDEX_EMPTY || cell == INDEX_FENCE;
+}
+
+static void id_index_clear_tail(_Atomic uint64_t* cells, uint64_t mask, uint64_t i) {
+    for (uint64_t n = 0; n < mask; n++, i = (i - 1) & mask) {
+        _Atomic uint64_t* next = &cells[(i + 1) & mask];
+        uint64_t empty = INDEX_EMPTY;
+        if (!atomic_compare_exchange_strong(next, &empty, INDEX_FENCE)) {
+            return;   // A cadeia continua depois desta célula
+        }
+        uint64_t tombstone = INDEX_TOMBSTONE;
+        int cleared = atomic_compare_exchange_strong(&cells[i], &tombstone, INDEX_EMPTY);
+        atomic_store(next, INDEX_EMPTY);
+        if (!cleared) {
+            return;   // Entrada viva, ou tombstone reaproveitada por um insert
+        }
+    }
+}
+
+// Nenhuma célula vazia entre home e pos (exclusive)
+static int id_index_path_intact(_Atomic uint64_t* cells, uint64_t mask, uint64_t home, uint64_t pos) {
+    for (uint64_t j = home; j != pos; j = (j + 1) & mask) {
+        if (index_cell_empty(atomic_load(&cells[j]))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Ids are unique, so an insert may take the first empty or tombstoned cell it sees.
+// A cell the insert had already passed may have been cleared behind it, leaving the
+// entry out of reach of its home; it then takes the entry out and inserts it again. The
+// slot is still WRITING, so no lookup can be looking for it yet.
+static void id_index_insert(TransactionPool* pool, int tx_id, int slot) {
+    _Atomic uint64_t* cells = id_index(pool);
+    uint64_t mask = (1ull << pool->id_index_bits) - 1;
+    uint64_t home = id_index_home(pool, tx_id);
+    uint64_t entry = INDEX_PACK(tx_id, slot);
+    uint64_t i = home;
+
+    for (uint64_t probes = 0; probes <= mask;) {
+        uint64_t cell = atomic_load(&cells[i]);
+        if (cell == INDEX_FENCE) {
+            sched_yield();   // Um remover está a limpar a célula anterior
+            continue;
+        }
+        if (cell == INDEX_EMPTY || cell == INDEX_TOMBSTONE) {
+            if (!atomic_compare_exchange_strong(&cells[i], &cell, entry)) {
+                continue;    // Outro escritor mudou a célula: relê-a
+            }
+            if (id_index_path_intact(cells, mask, home, i)) {
+                return;
+            }
+            atomic_store(&cells[i], INDEX_TOMBSTONE);
+            id_index_clear_tail(cells, mask, i);
+            i = home;
+            probes = 0;
+            continue;
+        }
+        probes++;
+        i = (i + 1) & mask;
+    }
+}
+
+static void id_index_remove(TransactionPool* pool, int tx_id, int slot) {
+    _Atomic uint64_t* cells = id_index(pool);
+    uint64_t mask = (1ull << pool->id_index_bits) - 1;
+    uint64_t i = id_index_home(pool, tx_id);
+    uint64_t entry = INDEX_PACK(tx_id, slot);
+
+    for (uint64_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+        uint64_t cell = atomic_load_explicit(&cells[i], memory_order_relaxed);
+        if (index_cell_empty(cell)) {
+            return;
+        }
+        if (cell == entry) {
+            // Tombstone em vez de vazio: não corta a cadeia de sondagem de outras chaves
+            if (atomic_compare_exchange_strong(&cells[i], &cell, INDEX_TOMBSTONE)) {
+                id_index_clear_tail(cells, mask, i);
+            }
+            return;
+        }
+    }
+}
+
+// Bounded MPMC queue (Vyukov): each cell's sequence number says whether it is free
+// for the producer at `pos` or holds a value for the consumer at `pos`.
+static int bucket_push(TransactionPool* pool, TxRewardBucket* bucket, int slot) {
+    TxBucketCell* cells = bucket_cells(pool, bucket);
+    uint64_t pos = atomic_load_explicit(&bucket->enqueue_pos, memory_order_relaxed);
+    TxBucketCell* cell;
+
+    for (;;) {
+        cell = &cells[pos & bucket->mask];
+        uint64_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak(&bucket->enqueue_pos, &pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Nunca está cheia (capacidade >= pool_size): a célula ainda pertence a um consumidor
+            // da volta anterior, desescalonado entre o CAS e a libertação. Desistir aqui perdia
+            // a transação (READY fora de qualquer bucket), por isso espera que ele acabe.
+            sched_yield();
+            pos = atomic_load_explicit(&bucket->enqueue_pos, memory_order_relaxed);
+        } else {
+            pos = atomic_load_explicit(&bucket->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    cell->slot = (uint32_t)slot;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+static int bucket_pop(TransactionPool* pool, TxRewardBucket* bucket) {
+    TxBucketCell* cells = bucket_cells(pool, bucket);
+    uint64_t pos = atomic_load_explicit(&bucket->dequeue_pos, memory_order_relaxed);
+    TxBucketCell* cell;
+
+    for (;;) {
+        cell = &cells[pos & bucket->mask];
+        uint64_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak(&bucket->dequeue_pos, &pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;   // Vazia
+        } else {
+            pos = atomic_load_explicit(&bucket->dequeue_pos, memory_order_relaxed);
+        }
+    }
+
+    int slot = (int)cell->slot;
+    atomic_store_explicit(&cell->seq, pos + bucket->mask + 1, memory_order_release);
+    return slot;
+}
+
+// Cada slot volta sempre à pilha do seu shard
+static void free_stack_push(TransactionPool* pool, int slot) {
+    _Atomic uint64_t* free_head = &slot_shard(pool, slot)->free_head;
+    _Atomic uint32_t* next = free_next(pool);
+    uint64_t head = atomic_load(free_head);
+    do {
+        atomic_store_explicit(&next[slot], FREE_SLOT1(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak(free_head, &head, FREE_PACK(FREE_TAG(head) + 1, slot + 1)));
+}
+
+static int free_stack_pop(TransactionPool* pool, TxPoolShard* shard) {
+    _Atomic uint32_t* next = free_next(pool);
+    uint64_t head = atomic_load(&shard->free_head);
+    for (;;) {
+        uint32_t slot1 = FREE_SLOT1(head);
+        if (slot1 == 0) {
+            return -1;
+        }
+        // A tag impede ABA se o slot for retirado e devolvido entretanto
+        uint32_t after = atomic_load_explicit(&next[slot1 - 1], memory_order_relaxed);
+        if (atomic_compare_exchange_weak(&shard->free_head, &head, FREE_PACK(FREE_TAG(head) + 1, after))) {
+            return (int)slot1 - 1;
+        }
+    }
+}
+
+void tx_pool_init(TransactionPool* pool, int pool_size, int shards, int block_threshold, int lease_seconds) {
+    size_t buckets, total;
+    tx_pool_layout(pool_size, shards, &pool->transactions_pending_set, &pool->slot_state_offset, &pool->free_next_offset,
+                   &pool->ready_bitmap_offset, &buckets, &pool->id_index_offset, &total);
+    pool->pool_size = pool_size;
+    pool->shard_count = shards;
+    pool->shard_slots = shard_slots(pool_size, shards);
+    pool->lease_seconds = lease_seconds;
+    pool->block_threshold = (uint32_t)block_threshold;
+    atomic_store(&pool->ready_seq, 0);
+    atomic_store(&pool->ready_waiters, 0);
+    atomic_store(&pool->space_seq, 0);
+    atomic_store(&pool->space_waiters, 0);
+    atomic_store(&pool->tx_id_seq, 0);
+    pool->id_index_bits = id_index_bits(pool_size);
+    for (uint64_t i = 0; i < (1ull << pool->id_index_bits); i++) {
+        atomic_store(&id_index(pool)[i], INDEX_EMPTY);
+    }
+
+    uint64_t capacity = bucket_capacity(pool->shard_slots);
+    for (int s = 0; s < shards; s++) {
+        TxPoolShard* shard = &pool->shards[s];
+        atomic_store(&shard->ready_count, 0);
+        for (int r = 0; r < TX_REWARD_LEVELS; r++) {
+            TxRewardBucket* bucket = &shard->reward_buckets[r];
+            bucket->cells_offset = buckets + sizeof(TxBucketCell) * capacity * (size_t)(s * TX_REWARD_LEVELS + r);
+            bucket->mask = capacity - 1;
+            atomic_store(&bucket->enqueue_pos, 0);
+            atomic_store(&bucket->dequeue_pos, 0);
+            for (uint64_t c = 0; c < capacity; c++) {
+                atomic_store(&bucket_cells(pool, bucket)[c].seq, c);
+            }
+        }
+    }
+
+    atomic_store(&pool->hash_seq, 0);
+    memset(pool->current_block_hash, '0', HASH_SIZE - 1);
+    pool->current_block_hash[HASH_SIZE - 1] = '\0';
+
+    _Atomic uint64_t* states = slot_states(pool);
+    _Atomic uint32_t* next = free_next(pool);
+    for (int i = 0; i < pool_size; i++) {
+        pending_ids(pool)[i] = 0;
+        atomic_store(&states[i], TX_SLOT_EMPTY);
+        // Pilha inicial de cada shard: o primeiro slot no topo, ligado aos seguintes do mesmo shard
+        int last = (i + 1) % pool->shard_slots == 0 || i + 1 == pool_size;
+        atomic_store(&next[i], last ? 0 : (uint32_t)(i + 2));
+    }
+    for (int w = 0; w < bitmap_words(pool_size); w++) {
+        atomic_store(&ready_bitmap(pool)[w], 0);
+        atomic_store(&occupancy_bitmap(pool)[w], 0);
+    }
+    for (int s = 0; s < shards; s++) {
+        atomic_store(&pool->shards[s].free_head, FREE_PACK(0, s * pool->shard_slots + 1));
+    }
+}
+
+// Publica a transação num slot livre, sem mexer em ready_count (fica a cargo de quem chama).
+// O slot vem do shard do sender; se esse estiver cheio, do primeiro seguinte com espaço.
+static int insert_one(TransactionPool* pool, const Transaction* t) {
+    int home = sender_shard(pool, t->sender_id);
+    int slot = -1;
+    for (int k = 0; k < pool->shard_count && slot < 0; k++) {
+        slot = free_stack_pop(pool, &pool->shards[(home + k) % pool->shard_count]);
+    }
+    if (slot < 0) {
+        return -1;
+    }
+
+    atomic_store_explicit(&slot_states(pool)[slot], TX_SLOT_WRITING, memory_order_relaxed);
+    atomic_fetch_or_explicit(&occupancy_bitmap(pool)[slot / 64], 1ull << (slot % 64), memory_order_relaxed);
+    pending_ids(pool)[slot] = t->id;
+    pending_rewards(pool)[slot] = (uint8_t)t->reward;
+    pending_ages(pool)[slot] = t->age;
+    pending_payload(pool)[slot] = (TxPayload){
+        .timestamp = t->timestamp, .sender_id = t->sender_id, .receiver_id = t->receiver_id, .value = t->value,
+    };
+    id_index_insert(pool, t->id, slot);
+
+    // Publica: a escrita da transação fica visível antes do estado READY e do bit
+    atomic_store_explicit(&slot_states(pool)[slot], TX_SLOT_READY, memory_order_release);
+    atomic_fetch_or(&ready_bitmap(pool)[slot / 64], 1ull << (slot % 64));
+    bucket_push(pool, reward_bucket(slot_shard(pool, slot), t->reward), slot);
+    return slot;
+}
+
+int tx_pool_insert(TransactionPool* pool, const Transaction* t) {
+    int slot = insert_one(pool, t);
+    if (slot >= 0) {
+        ready_count_add(pool, slot_shard(pool, slot), 1);
+    }
+    return slot;
+}
+
+// Lote inteiro com uma só atualização de ready_count por shard: os miners veem as
+// transações chegar em blocos e o futex é acordado no máximo uma vez por lote.
+int tx_pool_insert_batch(TransactionPool* pool, const Transaction* txs, int n, int* slots) {
+    uint32_t added[TX_POOL_MAX_SHARDS] = {0};
+    int inserted = 0;
+    while (inserted < n) {
+        int slot = insert_one(pool, &txs[inserted]);
+        if (slot < 0) {
+            break;
+        }
+        added[slot / pool->shard_slots]++;
+        slots[inserted++] = slot;
+    }
+    for (int s = 0; s < pool->shard_count; s++) {
+        if (added[s] > 0) {
+            ready_count_add(pool, &pool->shards[s], added[s]);
+        }
+    }
+    return inserted;
+}
+
+// Shards com transações prontas, a começar pelo mais cheio e depois em round-robin.
+// Um só passe pelos contadores: os shards vazios não custam pops nas filas.
+static int ready_shards(TransactionPool* pool, int* order) {
+    int32_t counts[TX_POOL_MAX_SHARDS];
+    int best = 0;
+    for (int s = 0; s < pool->shard_count; s++) {
+        counts[s] = (int32_t)atomic_load_explicit(&pool->shards[s].ready_count, memory_order_relaxed);
+        if (counts[s] > counts[best]) {
+            best = s;
+        }
+    }
+
+    int n = 0;
+    for (int k = 0; k < pool->shard_count; k++) {
+        int s = (best + k) % pool->shard_count;
+        if (counts[s] > 0) {
+            order[n++] = s;
+        }
+    }
+    return n;
+}
+
+// Top-k selection: highest reward first and, within a reward, oldest first (FIFO) per
+// shard. Costs O(k) queue pops plus one pass over the shard counters instead of a scan
+// over pool_size slots; entries whose slot is no longer READY are simply dropped. Each
+// slot taken is leased to `owner`.
+int tx_pool_claim(TransactionPool* pool, int owner, Transaction* out, int* slots, int max) {
+    _Atomic uint64_t* states = slot_states(pool);
+    uint64_t lease = TX_SLOT_LEASE(owner, lease_clock() + (uint32_t)pool->lease_seconds);
+    uint32_t taken[TX_POOL_MAX_SHARDS] = {0};
+    int order[TX_POOL_MAX_SHARDS];
+    int shards = ready_shards(pool, order);
+    int claimed = 0;
+
+    for (int r = TX_REWARD_LEVELS; r >= 1 && claimed < max; r--) {
+        for (int k = 0; k < shards && claimed < max; k++) {
+            int s = order[k];
+            TxRewardBucket* bucket = reward_bucket(&pool->shards[s], r);
+
+            while (claimed < max) {
+                int slot = bucket_pop(pool, bucket);
+                if (slot < 0) {
+                    break;
+                }
+
+                uint64_t expected = TX_SLOT_READY;
+                if (atomic_compare_exchange_strong(&states[slot], &expected, lease)) {
+                    atomic_fetch_and(&ready_bitmap(pool)[slot / 64], ~(1ull << (slot % 64)));
+                    tx_pool_read_slot(pool, slot, &out[claimed]);
+                    slots[claimed] = slot;
+                    taken[s]++;
+                    claimed++;
+                }
+            }
+        }
+    }
+    for (int s = 0; s < pool->shard_count; s++) {
+        if (taken[s] > 0) {
+            atomic_fetch_sub(&pool->shards[s].ready_count, taken[s]);
+        }
+    }
+    return claimed;
+}
+
+// Devolve um slot reservado à pool (READY) e à fila da sua reward
+static int lease_return(TransactionPool* pool, int slot, uint64_t word) {
+    if (!atomic_compare_exchange_strong(&slot_states(pool)[slot], &word, TX_SLOT_READY)) {
+        return -1;
+    }
+    TxPoolShard* shard = slot_shard(pool, slot);
+    atomic_fetch_or(&ready_bitmap(pool)[slot / 64], 1ull << (slot % 64));
+    bucket_push(pool, reward_bucket(shard, pending_rewards(pool)[slot]), slot);
+    ready_count_add(pool, shard, 1);
+    return 0;
+}
+
+int tx_pool_release(TransactionPool* pool, int slot, int owner) {
+    uint64_t word = atomic_load(&slot_states(pool)[slot]);
+    if (TX_SLOT_STATE(word) != TX_SLOT_CLAIMED || TX_SLOT_OWNER(word) != owner) {
+        return -1;   // A reserva expirou e pertence agora a outro miner
+    }
+    return lease_return(pool, slot, word);
+}
+
+int tx_pool_remove(TransactionPool* pool, int slot, int owner) {
+    _Atomic uint64_t* state = &slot_states(pool)[slot];
+    uint64_t word = atomic_load(state);
+
+    if (TX_SLOT_STATE(word) != TX_SLOT_CLAIMED || TX_SLOT_OWNER(word) != owner ||
+        !atomic_compare_exchange_strong(state, &word, TX_SLOT_EMPTY)) {
+        return -1;
+    }
+
+    // Sai do índice antes de o slot poder ser reutilizado
+    id_index_remove(pool, pending_ids(pool)[slot], slot);
+    atomic_fetch_and_explicit(&occupancy_bitmap(pool)[slot / 64], ~(1ull << (slot % 64)), memory_order_relaxed);
+    free_stack_push(pool, slot);
+    if (atomic_load(&pool->space_waiters)) {
+        atomic_fetch_add(&pool->space_seq, 1);
+        futex_wake_all(&pool->space_seq);
+    }
+    return 0;
+}
+
+// Pushes the expiry of the slots still leased to `owner` forward. A lease that expired
+// but was not reaped yet is kept; one already taken by someone else is not.
+int tx_pool_renew(TransactionPool* pool, const int* slots, int n, int owner) {
+    uint32_t expiry = lease_clock() + (uint32_t)pool->lease_seconds;
+    uint64_t lease = TX_SLOT_LEASE(owner, expiry);
+    int held = 0;
+
+    for (int i = 0; i < n; i++) {
+        _Atomic uint64_t* state = &slot_states(pool)[slots[i]];
+        uint64_t word = atomic_load(state);
+
+        while (TX_SLOT_STATE(word) == TX_SLOT_CLAIMED && TX_SLOT_OWNER(word) == owner) {
+            // Renovada há menos de um segundo: evita o CAS
+            if ((int32_t)(expiry - TX_SLOT_EXPIRY(word)) <= 0 ||
+                atomic_compare_exchange_weak(state, &word, lease)) {
+                held++;
+                break;
+            }
+        }
+    }
+    return held;
+}
+
+// Returns expired leases to the pool (e.g. a miner that died mid-block). A block that
+// still carries one of these transactions is rejected by the validator, since the
+// transaction is no longer leased to that block's miner.
+//
+// Only occupied slots that are not READY can hold a lease, so the scan walks the two
+// bitmaps a word (64 slots) at a time and reads the state word of those slots alone.
+int tx_pool_reap_expired(TransactionPool* pool) {
+    _Atomic uint64_t* states = slot_states(pool);
+    uint32_t now = lease_clock();
+    int reaped = 0;
+
+    for (int w = 0; w < bitmap_words(pool->pool_size); w++) {
+        uint64_t leased = atomic_load_explicit(&occupancy_bitmap(pool)[w], memory_order_relaxed) &
+                          ~atomic_load_explicit(&ready_bitmap(pool)[w], memory_order_relaxed);
+        while (leased != 0) {
+            int i = w * 64 + __builtin_ctzll(leased);
+            leased &= leased - 1;
+
+            uint64_t word = atomic_load_explicit(&states[i], memory_order_relaxed);
+            if (TX_SLOT_STATE(word) == TX_SLOT_CLAIMED && (int32_t)(now - TX_SLOT_EXPIRY(word)) >= 0 &&
+                lease_return(pool, i, word) == 0) {
+                reaped++;
+            }
+        }
+    }
+    return reaped;
+}
+
+void tx_pool_read_slot(TransactionPool* pool, int slot, Transaction* out) {
+    const TxPayload* payload = &pending_payload(pool)[slot];
+    out->id = pending_ids(pool)[slot];
+    out->reward = pending_rewards(pool)[slot];
+    out->age = pending_ages(pool)[slot];
+    out->sender_id = payload->sender_id;
+    out->receiver_id = payload->receiver_id;
+    out->value = payload->value;
+    out->timestamp = payload->timestamp;
+    out->empty = 0;
+}
+
+int tx_pool_occupied(TransactionPool* pool) {
+    int occupied = 0;
+    for (int w = 0; w < bitmap_words(pool->pool_size); w++) {
+        occupied += __builtin_popcountll(atomic_load_explicit(&occupancy_bitmap(pool)[w], memory_order_relaxed));
+    }
+    return occupied;
+}
+
+int tx_pool_slot_state(TransactionPool* pool, int slot) {
+    return TX_SLOT_STATE(atomic_load_explicit(&slot_states(pool)[slot], memory_order_acquire));
+}
+
+int tx_pool_slot_owner(TransactionPool* pool, int slot) {
+    uint64_t word = atomic_load_explicit(&slot_states(pool)[slot], memory_order_acquire);
+    return TX_SLOT_STATE(word) == TX_SLOT_CLAIMED ? TX_SLOT_OWNER(word) : -1;
+}
+
+int tx_pool_find(TransactionPool* pool, int tx_id) {
+    _Atomic uint64_t* cells = id_index(pool);
+    uint64_t mask = (1ull << pool->id_index_bits) - 1;
+    uint64_t i = id_index_home(pool, tx_id);
+
+    for (uint64_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+        uint64_t cell = atomic_load_explicit(&cells[i], memory_order_acquire);
+        if (index_cell_empty(cell)) {
+            return -1;
+        }
+        if (cell == INDEX_TOMBSTONE || INDEX_ID(cell) != (uint32_t)tx_id) {
+            continue;
+        }
+
+        // Confirma no slot: a entrada pode estar a ser removida concorrentemente
+        int slot = (int)INDEX_SLOT1(cell) - 1;
+        int state = tx_pool_slot_state(pool, slot);
+        if ((state == TX_SLOT_READY || state == TX_SLOT_CLAIMED) &&
+            pending_ids(pool)[slot] == tx_id) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+int tx_pool_wait_ready(TransactionPool* pool, int timeout_ms) {
+    if (tx_pool_ready_count(pool) >= pool->block_threshold) {
+        return 1;
+    }
+
+    // Registado como waiter antes de ler `seen` e voltar a contar: um produtor que some
+    // depois disto vê o waiter e muda ready_seq, e o futex não dorme
+    atomic_fetch_add(&pool->ready_waiters, 1);
+    uint32_t seen = atomic_load(&pool->ready_seq);
+    if (tx_pool_ready_count(pool) < pool->block_threshold) {
+        futex_wait(&pool->ready_seq, seen, timeout_ms);
+    }
+    atomic_fetch_sub(&pool->ready_waiters, 1);
+    return tx_pool_ready_count(pool) >= pool->block_threshold;
+}
+
+static int tx_pool_has_space(TransactionPool* pool) {
+    for (int s = 0; s < pool->shard_count; s++) {
+        if (FREE_SLOT1(atomic_load(&pool->shards[s].free_head)) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Mesmo protocolo de tx_pool_wait_ready, acordado por tx_pool_remove
+int tx_pool_wait_space(TransactionPool* pool, int timeout_ms) {
+    if (tx_pool_has_space(pool)) {
+        return 1;
+    }
+
+    atomic_fetch_add(&pool->space_waiters, 1);
+    uint32_t seen = atomic_load(&pool->space_seq);
+    if (!tx_pool_has_space(pool)) {
+        futex_wait(&pool->space_seq, seen, timeout_ms);
+    }
+    atomic_fetch_sub(&pool->space_waiters, 1);
+    return tx_pool_has_space(pool);
+}
+
+void tx_pool_wake_waiters(TransactionPool* pool) {
+    atomic_fetch_add(&pool->ready_seq, 1);
+    futex_wake_all(&pool->ready_seq);
+}
+
+// Seqlock: o validator é o único escritor do hash; os miners repetem a leitura se apanharem uma escrita
+void tx_pool_get_current_hash(TransactionPool* pool, char hash[HASH_SIZE]) {
+    uint32_t before, after;
+    do {
+        before = atomic_load_explicit(&pool->hash_seq, memory_order_acquire);
+        memcpy(hash, pool->current_block_hash, HASH_SIZE);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&pool->hash_seq, memory_order_relaxed);
+    } while (before != after || (before & 1));
+    hash[HASH_SIZE - 1] = '\0';
+}
+
+uint64_t tx_pool_reserve_ids(TransactionPool* pool, int count) {
+    return atomic_fetch_add_explicit(&pool->tx_id_seq, (uint64_t)count, memory_order_relaxed);
+}
+
+void tx_pool_seed_ids(TransactionPool* pool, int last_id) {
+    atomic_store(&pool->tx_id_seq, last_id > 0 ? (uint64_t)last_id : 0);
+}
+
+void tx_pool_set_current_hash(TransactionPool* pool, const char hash[HASH_SIZE]) {
+    atomic_fetch_add_explicit(&pool->hash_seq, 1, memory_order_acq_rel);
+    memcpy(pool->current_block_hash, hash, HASH_SIZE);
+    atomic_fetch_add_explicit(&pool->hash_seq, 1, memory_order_release);
+}
@@ -0,0 +1,84 @@
+#ifndef TX_POOL_H
+#define TX_POOL_H
+
+#include "common.h"
+
+// Estado de um slot da pool (byte menos significativo da palavra de estado)
+enum {
+    TX_SLOT_EMPTY = 0,
+    TX_SLOT_WRITING,     // Reservado por um txgen, transação a ser escrita
+    TX_SLOT_READY,       // Publicada, pode ser reclamada por um miner
+    TX_SLOT_CLAIMED,     // Num bloco candidato, à espera do validator
+};
+
+#define TX_DEFAULT_LEASE_SECONDS 30
+
+// Palavra de estado: bits 0-7 estado, 8-23 dono (miner id + 1), 32-63 fim da reserva
+// (segundos de CLOCK_MONOTONIC). Dono e expiração só têm significado em TX_SLOT_CLAIMED.
+#define TX_SLOT_STATE(word) ((int)((word) & 0xff))
+#define TX_SLOT_OWNER(word) ((int)(((word) >> 8) & 0xffff) - 1)
+#define TX_SLOT_EXPIRY(word) ((uint32_t)((word) >> 32))
+#define TX_SLOT_LEASE(owner, expiry) \
+    (((uint64_t)(expiry) << 32) | ((uint64_t)(((owner) + 1) & 0xffff) << 8) | TX_SLOT_CLAIMED)
+
+// Lock-free transaction pool. Free slots sit on a tagged Treiber stack, so inserts are
+// O(1). Ready slots are tracked in a bitmap and, for selection, in one FIFO
+// queue per reward level, so miners take the top-k transactions by reward and age.
+// An open-addressing table maps transaction ids to slots for the validator's lookups.
+// Pending transactions are stored as structure-of-arrays (see TxPendingSet): scans use
+// the occupancy and ready bitmaps and the id/reward arrays, never the payload.
+// Every transition is a CAS on the slot's state word, so no global lock is taken.
+//
+// The pool is split into shards of contiguous slots, each with its own free stack,
+// reward queues and ready counter on separate cache lines. Producers insert into the
+// shard of their sender_id (spilling over when it is full), so concurrent txgens do not
+// contend on the same CAS targets; miners start at the fullest shard and go round-robin.
+//
+// Claims are leases: a miner reserves disjoint transactions under its id until an
+// expiry. Only the owner can release, renew or commit them; once a lease expires,
+// tx_pool_reap_expired returns the slot to the other miners. Miners renew their leases
+// while the PoW search runs, so only a miner that stopped making progress loses them.
+int tx_pool_shard_count(int pool_size, int requested);   // Nº efetivo de shards (requested 0 = automático)
+size_t tx_pool_size(int pool_size, int shards);
+void tx_pool_init(TransactionPool* pool, int pool_size, int shards, int block_threshold, int lease_seconds);
+
+int tx_pool_insert(TransactionPool* pool, const Transaction* t);     // slot, ou -1 se cheia
+int tx_pool_insert_batch(TransactionPool* pool, const Transaction* txs, int n, int* slots);   // Nº inserido
+int tx_pool_claim(TransactionPool* pool, int owner, Transaction* out, int* slots, int max);
+int tx_pool_release(TransactionPool* pool, int slot, int owner);      // CLAIMED -> READY, 0 se era do owner
+int tx_pool_remove(TransactionPool* pool, int slot, int owner);       // CLAIMED -> EMPTY (commit)
+int tx_pool_renew(TransactionPool* pool, const int* slots, int n, int owner);   // Nº ainda reservados
+int tx_pool_reap_expired(TransactionPool* pool);                      // Reservas expiradas devolvidas
+int tx_pool_find(TransactionPool* pool, int tx_id);                   // slot ou -1, O(1) esperado
+int tx_pool_slot_state(TransactionPool* pool, int slot);
+int tx_pool_slot_owner(TransactionPool* pool, int slot);              // dono da reserva, ou -1
+uint32_t tx_pool_ready_count(TransactionPool* pool);                  // Soma dos shards
+int tx_pool_occupied(TransactionPool* pool);                          // Slots não vazios (popcount)
+void tx_pool_read_slot(TransactionPool* pool, int slot, Transaction* out);   // Junta os arrays e o payload
+
+// Miners sleep on a futex in the pool until a full block's worth of transactions is
+// ready. Producers only sum the shard counters when someone is asleep, and wake the
+// miners once the total reaches block_threshold.
+int tx_pool_wait_ready(TransactionPool* pool, int timeout_ms);         // 1 se há um bloco completo
+void tx_pool_wake_waiters(TransactionPool* pool);
+
+// Producers that find the pool full sleep on a second futex, woken by tx_pool_remove
+// when the validator frees a slot (only if someone is asleep).
+int tx_pool_wait_space(TransactionPool* pool, int timeout_ms);         // 1 se há slots livres
+
+// Transaction ids come from one counter in the pool segment, shared by every txgen
+// process and thread: one fetch_add per batch. The validator looks transactions up by
+// id, so ids must not repeat while a transaction is pending, leased or in a block.
+// The controller seeds the counter after the largest id already in the chain; ids only
+// wrap around after TX_ID_MAX transactions.
+#define TX_ID_MAX INT32_MAX
+uint64_t tx_pool_reserve_ids(TransactionPool* pool, int count);   // Sequência do primeiro de count ids
+void tx_pool_seed_ids(TransactionPool* pool, int last_id);         // O próximo id é last_id + 1
+static inline int tx_pool_id_at(uint64_t seq) {
+    return (int)(seq % TX_ID_MAX) + 1;
+}
+
+void tx_pool_get_current_hash(TransactionPool* pool, char hash[HASH_SIZE]);
+void tx_pool_set_current_hash(TransactionPool* pool, const char hash[HASH_SIZE]);
+
+#endif
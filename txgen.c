@@ -2,13 +2,18 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
+#include <math.h>
+#include <errno.h>
+#include <pthread.h>
 #include <signal.h>
 #include <sys/mman.h>
-#include <semaphore.h>
 #include <fcntl.h>
 #include <string.h>
 #include "logging.h"
 #include "common.h"  // Inclui Transaction, Config, TX_POOL_SHM
+#include "tx_pool.h"
+#include "trace.h"
+#include "stats.h"
 
 volatile sig_atomic_t stop_requested = 0;
 
@@ -18,22 +23,298 @@ void handle_sigint(int sig) {
     stop_requested = 1;
 }
 
-sem_t* init_semaphore(const char* name) {
-    sem_t* sem = sem_open(name, 0);
-    if (sem == SEM_FAILED) {
-        log_message("ERROR: sem_open falhou para %s", name);
-        exit(EXIT_FAILURE);
+// ---------------------------------------------------------------------------
+// Modo gerador de carga (open loop): txgen -r <tx/s> [-t threads] [-b lote] [-a poisson|constant] [-w reward]
+// As chegadas seguem um calendário fixo, independente do que a pool aceita; cada transação
+// leva como timestamp a hora agendada, para que o atraso do gerador conte na latência.
+// ---------------------------------------------------------------------------
+
+#define TXGEN_MAX_THREADS 64
+#define TXGEN_MAX_BATCH 256
+#define TXGEN_DEFAULT_BATCH 32
+#define TXGEN_LAG_WARN_MS 100        // Atraso face ao calendário a partir do qual o relatório avisa
+#define TXGEN_PUSHBACK_WAIT_MS 100   // Espera máxima por espaço antes de voltar a ver o SIGINT
+
+typedef enum {
+    ARRIVAL_CONSTANT = 0,
+    ARRIVAL_POISSON,
+} ArrivalMode;
+
+typedef struct {
+    double rate;           // tx/s do processo, repartidas pelas threads
+    int threads;
+    int batch;             // Máximo de transações publicadas por sincronização
+    ArrivalMode arrivals;
+    int reward;            // 1..3, ou 0 para reward aleatório por transação
+} LoadOptions;
+
+// Contadores de uma thread geradora, lidos pela thread principal para os relatórios
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t sent;
+    _Atomic uint64_t batches;
+    _Atomic uint64_t pushbacks;      // Lotes que encontraram a pool sem espaço
+    _Atomic uint64_t pushback_ns;    // Tempo bloqueado à espera de espaço
+    _Atomic uint64_t max_lag_ns;     // Maior atraso desde o último relatório
+    _Atomic uint64_t lag_ns;         // Atraso do último lote publicado
+} GeneratorStats;
+
+typedef struct {
+    int index;
+    pthread_t thread;
+    GeneratorStats stats;
+} Generator;
+
+static LoadOptions load;
+
+static uint64_t next_interarrival_ns(double rate, unsigned int* seed) {
+    if (load.arrivals == ARRIVAL_POISSON) {
+        double u = (rand_r(seed) + 1.0) / ((double)RAND_MAX + 2.0);   // (0, 1)
+        return (uint64_t)(-log(u) / rate * 1e9);
+    }
+    return (uint64_t)(1e9 / rate);
+}
+
+static void update_max(_Atomic uint64_t* max, uint64_t value) {
+    uint64_t seen = atomic_load_explicit(max, memory_order_relaxed);
+    while (value > seen && !atomic_compare_exchange_weak_explicit(max, &seen, value,
+                                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Pool cheia: espera que o validator liberte slots. Devolve 0 só com stop_requested.
+static int wait_for_space(Generator* g) {
+    int space = 0;
+    atomic_fetch_add_explicit(&g->stats.pushbacks, 1, memory_order_relaxed);
+    uint64_t wait_start = trace_now_ns();
+    while (!stop_requested && !(space = tx_pool_wait_space(tx_pool_ptr, TXGEN_PUSHBACK_WAIT_MS))) {
+    }
+    uint64_t waited = trace_now_ns() - wait_start;
+    atomic_fetch_add_explicit(&g->stats.pushback_ns, waited, memory_order_relaxed);
+    STATS_ADD(pool_full_ns, waited);
+    return space;
+}
+
+static void publish_batch(Generator* g, Transaction* batch, int n) {
+    int slots[TXGEN_MAX_BATCH];
+    int done = 0;
+
+    while (done < n && !stop_requested) {
+        int inserted = tx_pool_insert_batch(tx_pool_ptr, &batch[done], n - done, slots);
+        for (int i = 0; i < inserted; i++) {
+            trace_tx(TRACE_TX_INSERT, batch[done + i].id, slots[i], -1, batch[done + i].reward);
+        }
+        done += inserted;
+        STATS_ADD(tx_inserted, inserted);
+        atomic_fetch_add_explicit(&g->stats.sent, (uint64_t)inserted, memory_order_relaxed);
+
+        if (done < n && !wait_for_space(g)) {
+            break;
+        }
+    }
+
+    // Atraso da transação mais antiga do lote face à hora agendada
+    uint64_t lag = trace_now_ns() - batch[0].timestamp;
+    atomic_store_explicit(&g->stats.lag_ns, lag, memory_order_relaxed);
+    update_max(&g->stats.max_lag_ns, lag);
+    atomic_fetch_add_explicit(&g->stats.batches, 1, memory_order_relaxed);
+}
+
+static void* generator_main(void* arg) {
+    Generator* g = arg;
+    double rate = load.rate / load.threads;
+    unsigned int seed = (unsigned int)(getpid() ^ (g->index * 2654435761u) ^ trace_now_ns());
+    Transaction batch[TXGEN_MAX_BATCH];
+
+    // No modo constante as threads ficam intercaladas, 1/rate umas das outras
+    uint64_t next = trace_now_ns() + (uint64_t)(g->index * 1e9 / load.rate);
+
+    while (!stop_requested) {
+        uint64_t now = trace_now_ns();
+        if (next > now) {
+            // Acorda pelo menos a cada TXGEN_PUSHBACK_WAIT_MS para ver o stop_requested
+            uint64_t wake = next - now > TXGEN_PUSHBACK_WAIT_MS * 1000000ull ?
+                            now + TXGEN_PUSHBACK_WAIT_MS * 1000000ull : next;
+            struct timespec ts = { (time_t)(wake / 1000000000ull), (long)(wake % 1000000000ull) };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            continue;
+        }
+
+        // Todas as chegadas já vencidas entram no mesmo lote
+        int n = 0;
+        while (n < load.batch && next <= now) {
+            Transaction* t = &batch[n++];
+            t->reward = load.reward > 0 ? load.reward : rand_r(&seed) % 3 + 1;
+            t->sender_id = getpid();
+            t->receiver_id = rand_r(&seed) % 1000 + 1;
+            t->value = rand_r(&seed) % 100 + 1;
+            t->age = 0;
+            t->empty = 0;
+            t->timestamp = next;
+            next += next_interarrival_ns(rate, &seed);
+        }
+        // Um só fetch_add no contador partilhado para os ids do lote
+        uint64_t first = tx_pool_reserve_ids(tx_pool_ptr, n);
+        for (int i = 0; i < n; i++) {
+            batch[i].id = tx_pool_id_at(first + (uint64_t)i);
+        }
+        publish_batch(g, batch, n);
+    }
+    return NULL;
+}
+
+static int parse_load_options(int argc, char* argv[]) {
+    int opt;
+
+    load = (LoadOptions){ .rate = 0, .threads = 1, .batch = TXGEN_DEFAULT_BATCH,
+                          .arrivals = ARRIVAL_POISSON, .reward = 0 };
+    while ((opt = getopt(argc, argv, "r:t:b:a:w:")) != -1) {
+        switch (opt) {
+        case 'r': load.rate = atof(optarg); break;
+        case 't': load.threads = atoi(optarg); break;
+        case 'b': load.batch = atoi(optarg); break;
+        case 'w': load.reward = atoi(optarg); break;
+        case 'a':
+            if (strcmp(optarg, "poisson") == 0) {
+                load.arrivals = ARRIVAL_POISSON;
+            } else if (strcmp(optarg, "constant") == 0) {
+                load.arrivals = ARRIVAL_CONSTANT;
+            } else {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+        }
+    }
+    if (load.rate <= 0 || load.threads < 1 || load.threads > TXGEN_MAX_THREADS ||
+        load.batch < 1 || load.batch > TXGEN_MAX_BATCH || load.reward < 0 || load.reward > 3) {
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    uint64_t sent, batches, pushbacks, pushback_ns;
+} LoadTotals;
+
+static void collect_load(Generator* gens, LoadTotals* totals, uint64_t* max_lag, int reset_lag) {
+    memset(totals, 0, sizeof(*totals));
+    *max_lag = 0;
+    for (int i = 0; i < load.threads; i++) {
+        GeneratorStats* s = &gens[i].stats;
+        totals->sent += atomic_load_explicit(&s->sent, memory_order_relaxed);
+        totals->batches += atomic_load_explicit(&s->batches, memory_order_relaxed);
+        totals->pushbacks += atomic_load_explicit(&s->pushbacks, memory_order_relaxed);
+        totals->pushback_ns += atomic_load_explicit(&s->pushback_ns, memory_order_relaxed);
+        uint64_t lag = reset_lag ? atomic_exchange(&s->max_lag_ns, 0) : atomic_load(&s->max_lag_ns);
+        if (lag > *max_lag) {
+            *max_lag = lag;
+        }
+    }
+}
+
+static void run_load_generator(void) {
+    Generator* gens = calloc((size_t)load.threads, sizeof(Generator));
+    if (gens == NULL) {
+        LOG_ERROR(LOG_CAT_TXGEN, "ERROR: TxGen: failed to allocate %d generators", load.threads);
+        return;
+    }
+
+    char reward[8];
+    snprintf(reward, sizeof(reward), load.reward > 0 ? "%d" : "random", load.reward);
+    LOG_INFO(LOG_CAT_TXGEN, "TxGen load mode: %.1f tx/s, %s arrivals, %d thread(s), batches of up to %d, reward %s",
+             load.rate, load.arrivals == ARRIVAL_POISSON ? "poisson" : "constant", load.threads, load.batch, reward);
+
+    // Os geradores não recebem sinais: o SIGINT chega à thread principal
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    for (int i = 0; i < load.threads; i++) {
+        gens[i].index = i;
+        if (pthread_create(&gens[i].thread, NULL, generator_main, &gens[i]) != 0) {
+            LOG_ERROR(LOG_CAT_TXGEN, "ERROR: TxGen: failed to create generator thread %d", i);
+            stop_requested = 1;
+            load.threads = i;
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    // Relatório por segundo: ritmo real vs alvo, contrapressão da pool e atraso do calendário
+    LoadTotals before, now;
+    uint64_t max_lag;
+    uint64_t start_ns = trace_now_ns(), last_ns = start_ns;
+    collect_load(gens, &before, &max_lag, 1);
+    while (!stop_requested) {
+        sleep(1);
+        uint64_t t = trace_now_ns();
+        double seconds = (double)(t - last_ns) / 1e9;
+        collect_load(gens, &now, &max_lag, 1);
+
+        uint64_t batches = now.batches - before.batches;
+        LOG_INFO(LOG_CAT_TXGEN, "TXGEN: %.1f tx/s (target %.1f) | %.1f tx/batch | lag max %.1f ms",
+                 (now.sent - before.sent) / seconds, load.rate,
+                 batches > 0 ? (double)(now.sent - before.sent) / batches : 0.0, max_lag / 1e6);
+        if (now.pushbacks > before.pushbacks) {
+            LOG_WARN(LOG_CAT_TXGEN, "TXGEN: pool pushback: %llu batch(es) waited %.1f ms for free slots",
+                     (unsigned long long)(now.pushbacks - before.pushbacks),
+                     (now.pushback_ns - before.pushback_ns) / 1e6);
+        }
+        if (max_lag > (uint64_t)TXGEN_LAG_WARN_MS * 1000000ull) {
+            LOG_WARN(LOG_CAT_TXGEN, "TXGEN: generator %.1f ms behind schedule", max_lag / 1e6);
+        }
+        before = now;
+        last_ns = t;
     }
-    log_message("INFO: Semáforo %s aberto com sucesso", name);
-    return sem;
+
+    for (int i = 0; i < load.threads; i++) {
+        pthread_join(gens[i].thread, NULL);
+    }
+
+    collect_load(gens, &now, &max_lag, 0);
+    double total = (double)(trace_now_ns() - start_ns) / 1e9;
+    LOG_INFO(LOG_CAT_TXGEN, "TXGEN: sent %llu transactions in %.1f s (%.1f tx/s, target %.1f), "
+             "%llu pushback(s) totalling %.1f ms",
+             (unsigned long long)now.sent, total, total > 0 ? now.sent / total : 0.0, load.rate,
+             (unsigned long long)now.pushbacks, now.pushback_ns / 1e6);
+    free(gens);
 }
 
 int main(int argc, char *argv[]) {
     log_init("DEIChain_log.txt");
+    log_install_level_signals();
     load_config("config.cfg", &global_config);
+    if (global_config.log_async) {
+        log_attach_async();   // Sem controller em modo assíncrono, fica em modo síncrono
+    }
+    if (global_config.trace) {
+        trace_open(TRACE_FILE, 0);
+    }
+    open_stats_memory();
+
+    // Modo gerador de carga: txgen -r <tx/s> [...]
+    if (argc > 1 && argv[1][0] == '-') {
+        if (parse_load_options(argc, argv) != 0) {
+            LOG_ERROR(LOG_CAT_TXGEN, "ERROR: Incorrect usage. Syntax: %s -r <tx/s> [-t threads 1-%d] [-b batch 1-%d] "
+                      "[-a poisson|constant] [-w reward 0-3, 0 = random]", argv[0], TXGEN_MAX_THREADS, TXGEN_MAX_BATCH);
+            log_close();
+            return EXIT_FAILURE;
+        }
+
+        signal(SIGINT, handle_sigint);
+        open_tx_pool_memory(global_config.pool_size);
+        run_load_generator();
+
+        LOG_INFO(LOG_CAT_TXGEN, "TxGen terminated by SIGINT (PID=%d)", getpid());
+        close_stats_memory(0);
+        trace_close();
+        log_close();
+        return EXIT_SUCCESS;
+    }
 
     if (argc != 3) {
-        log_message("ERROR: Incorrect usage. Syntax: %s <reward 1-3> <sleep_time_ms 200-3000>", argv[0]);
+        LOG_ERROR(LOG_CAT_TXGEN, "ERROR: Incorrect usage. Syntax: %s <reward 1-3> <sleep_time_ms 200-3000> "
+                  "or %s -r <tx/s> [options]", argv[0], argv[0]);
         log_close();
         return EXIT_FAILURE;
     }
@@ -42,13 +323,13 @@ int main(int argc, char *argv[]) {
     int sleep_time = atoi(argv[2]);
 
     if (reward < 1 || reward > 3) {
-        log_message("ERROR: reward must be between 1 and 3. Received: %d", reward);
+        LOG_ERROR(LOG_CAT_TXGEN, "ERROR: reward must be between 1 and 3. Received: %d", reward);
         log_close();
         return EXIT_FAILURE;
     }
 
     if (sleep_time < 200 || sleep_time > 3000) {
-        log_message("ERROR: sleep_time must be between 200 and 3000 ms. Received: %d", sleep_time);
+        LOG_ERROR(LOG_CAT_TXGEN, "ERROR: sleep_time must be between 200 and 3000 ms. Received: %d", sleep_time);
         log_close();
         return EXIT_FAILURE;
     }
@@ -56,54 +337,45 @@ int main(int argc, char *argv[]) {
     srand(time(NULL) ^ getpid());
     signal(SIGINT, handle_sigint);
 
-    log_message("TxGen started with reward = %d and sleep_time = %d ms", reward, sleep_time);
+    LOG_INFO(LOG_CAT_TXGEN, "TxGen started with reward = %d and sleep_time = %d ms", reward, sleep_time);
 
     // Liga à memória partilhada da transaction pool
     open_tx_pool_memory(global_config.pool_size);
-    sem_t* sem_mutex = init_semaphore("/sem_mutex");
-    sem_t* sem_empty = init_semaphore("/sem_empty");
-    sem_t* sem_full  = init_semaphore("/sem_full");
-
-    int counter = 0;
 
     while (!stop_requested) {
         Transaction t;
-        t.id = getpid() * 10000 + counter++;
+        t.id = tx_pool_id_at(tx_pool_reserve_ids(tx_pool_ptr, 1));
         t.reward = reward;
         t.sender_id = getpid();
         t.receiver_id = rand() % 1000 + 1;
         t.value = rand() % 100 + 1;
         t.age = 0;
+        t.timestamp = trace_now_ns();
 
-        log_message("TRANSACTION | ID=%d | Reward=%d | From=%d | To=%d | Value=%d",
+        LOG_DEBUG(LOG_CAT_TXGEN, "TRANSACTION | ID=%d | Reward=%d | From=%d | To=%d | Value=%d",
             t.id, t.reward, t.sender_id, t.receiver_id, t.value);
 
-        sem_wait(sem_empty); // Enquanto houver espaçoes livres
-        sem_wait(sem_mutex); // Lock para acesso à região crítica
-        // Publica transação na primeira posição livre da pool
-        TransactionPool* pool = (TransactionPool*)tx_pool_ptr;
-        
-        for (int i = 0; i < pool->pool_size; i++) {
-            if (tx_pool_ptr->transactions_pending_set[i].empty) {
-                tx_pool_ptr->transactions_pending_set[i] = t;
-                tx_pool_ptr->transactions_pending_set[i].empty = 0;
-
-                log_message("TxGen: Inserida transação %d no slot %d", t.id, i);
-                break;
-            }
+        // Publica transação num slot livre da pool (pilha lock-free, sem mutex); cheia, espera por um
+        uint64_t wait_start = trace_now_ns();
+        int slot;
+        while ((slot = tx_pool_insert(tx_pool_ptr, &t)) < 0 && !stop_requested) {
+            tx_pool_wait_space(tx_pool_ptr, TXGEN_PUSHBACK_WAIT_MS);
         }
-
-        sem_post(sem_mutex); // Liberta o acesso à região crítica
-        sem_post(sem_full); // Informa que há uma nova transação disponível
+        STATS_ADD(pool_full_ns, trace_now_ns() - wait_start);
+        if (slot < 0) {
+            break;
+        }
+        // Os miners são acordados pela própria pool quando há um bloco completo
+        trace_tx(TRACE_TX_INSERT, t.id, slot, -1, t.reward);
+        STATS_ADD(tx_inserted, 1);
+        LOG_DEBUG(LOG_CAT_TXGEN, "TxGen: Inserida transação %d no slot %d", t.id, slot);
 
         usleep(sleep_time * 1000); // Espera antes de gerar a próxima
     }
 
-    sem_close(sem_mutex);
-    sem_close(sem_empty);
-    sem_close(sem_full);
-
-    log_message("TxGen terminated by SIGINT (PID=%d)", getpid());
+    LOG_INFO(LOG_CAT_TXGEN, "TxGen terminated by SIGINT (PID=%d)", getpid());
+    close_stats_memory(0);
+    trace_close();
     log_close();
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -1,147 +1,410 @@
 #include "common.h"  
 #include <sys/mman.h>
 #include "logging.h"
+#include "pow.h"
+#include "merkle.h"
+#include "block_ring.h"
+#include "validator.h"
+#include "tx_pool.h"
+#include "trace.h"
+#include "stats.h"
+#include "ledger.h"
+#include "archive.h"
+#include "accounts.h"
 #include <unistd.h>   
 #include <fcntl.h>  
 #include <signal.h>
+#include <time.h>
+#include <pthread.h>
+
+#define VALIDATOR_BATCH SHA256_MAX_LANES   // Blocos que um worker verifica de uma vez
 
-int fd = -1;
 static volatile sig_atomic_t running_validator = 1;
+static BlockRing* block_ring = NULL;
+static AccountTable* account_table = NULL;
+static AccountBatch account_batch;     // Journal do bloco aplicado por validate_block_state
+
+// Bloco consumido do ring e ainda por decidir
+typedef struct {
+    BlockRingSlot* slot;
+    int verified;            // Os workers já correram verify_block_contents
+    int verdict;             // O seu resultado (0 ou -1)
+} ValidationJob;
+
+// Janela dos blocos consumidos, pela ordem do ring (publish_seq). A thread principal
+// acrescenta no fim e decide a cabeça; os workers verificam por lotes a partir de `next`
+// (PoW, Merkle, presença das transações). O que depende da cadeia (encadeamento, reservas,
+// saldos) e o commit ficam na thread principal, um bloco de cada vez e pela ordem da janela,
+// por isso o ledger e a tabela de saldos continuam a ter um único escritor.
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t pending;      // Workers: há blocos por verificar (ou paragem)
+    pthread_cond_t verified;     // Thread principal: um lote ficou verificado
+    ValidationJob jobs[BLOCK_RING_SLOTS];
+    uint64_t head;               // Próximo a decidir
+    uint64_t next;               // Próximo a entregar a um worker
+    uint64_t tail;               // Próximo lugar livre
+    int stopping;
+} window = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .pending = PTHREAD_COND_INITIALIZER,
+    .verified = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_t verify_workers[VALIDATOR_MAX_THREADS];
+static int verify_worker_count = 0;
 
 void handle_sigint_validator(int sig) {
     (void)sig;
     running_validator = 0;  // Mudar a variável de controle apenas para o validator
-    log_message("INFO: SIGINT received by validator process, stopping validation...");
+    LOG_INFO(LOG_CAT_VALIDATOR, "INFO: SIGINT received by validator process, stopping validation...");
 }
 
 // Função para verificar se a transação está na pool
 int is_transaction_in_pool(int tx_id) {
-    TransactionPool* pool = (TransactionPool*)tx_pool_ptr;
-    for (int i = 0; i < global_config.pool_size; i++) {
-        if (!pool->transactions_pending_set[i].empty && pool->transactions_pending_set[i].id == tx_id) {
-            return 1;  // Transação encontrada na pool
-        }
-    }
-    return 0;  // Transação não encontrada na pool
+    return tx_pool_find(tx_pool_ptr, tx_id) >= 0;
 }
 
-void receive_block_from_miner(TransactionBlock* block) {
-
-    // Tentar ler o bloco completo (tamanho da estrutura TransactionBlock)
-    ssize_t bytes_read = read(fd, block, sizeof(TransactionBlock));  // Preenche o bloco passado
+// Regista o conteúdo de um bloco recebido (lido diretamente do slot do ring)
+void print_block(const TransactionBlock* block) {
+    LOG_DEBUG(LOG_CAT_VALIDATOR, "VALIDATOR: Block received from miner (ID: %s)", block->txb_id);
+    LOG_DEBUG(LOG_CAT_VALIDATOR, "VALIDATOR: Previous Block Hash: %s", block->previous_block_hash);
+    LOG_DEBUG(LOG_CAT_VALIDATOR, "VALIDATOR: Timestamp: %ld", block->timestamp);
+    LOG_DEBUG(LOG_CAT_VALIDATOR, "VALIDATOR: Nonce: %u", block->nonce);
 
-    // Verificar se o número de bytes lidos é igual ao tamanho da estrutura do bloco
-    if (bytes_read != sizeof(TransactionBlock)) {
-        log_message("ERROR: Incomplete block received. Expected %zu bytes, got %zd", sizeof(TransactionBlock), bytes_read);
-        return;  // Se a leitura falhar, tenta ler o próximo bloco
+    LOG_DEBUG(LOG_CAT_VALIDATOR, "VALIDATOR: Printing transactions in the block:");
+    for (int i = 0; i < global_config.transactions_per_block; i++) {
+        if (block->transactions[i].id != 0) {
+            const Transaction* t = &block->transactions[i];
+            LOG_DEBUG(LOG_CAT_VALIDATOR, "Transaction %d: ID = %d, Reward = %d, From = %d, To = %d, Value = %d, Age = %d",
+                        i + 1, t->id, t->reward, t->sender_id, t->receiver_id, t->value, t->age);
+        }
     }
+}
 
-    log_message("VALIDATOR: Block received from miner (ID: %s)", block->txb_id);
-    log_message("VALIDATOR: Previous Block Hash: %s", block->previous_block_hash);
-    log_message("VALIDATOR: Timestamp: %ld", block->timestamp);
-    log_message("VALIDATOR: Nonce: %u", block->nonce);
+// Verificações que só dependem do bloco: correm nos workers, em paralelo e fora de ordem.
+// pow_ok vem de pow_verify/pow_verify_batch
+static int verify_block_contents(const TransactionBlock* block, int pow_ok) {
+    // 1. Verificar pow (cabeçalho) e se a raiz de Merkle corresponde às transações do bloco
+    if (!pow_ok) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Bloco %s não satisfaz a dificuldade de PoW (%d).", block->txb_id, global_config.pow_difficulty);
+        return -1;
+    }
+    if (!merkle_block_matches(block, global_config.transactions_per_block)) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Raiz de Merkle do bloco %s não corresponde às transações.", block->txb_id);
+        return -1;
+    }
 
-    log_message("VALIDATOR: Printing transactions in the block:");
-    for (int i = 0; i < 10; i++) {
-        if (block->transactions[i].id != 0) {
-            Transaction* t = &block->transactions[i];
-            log_message("Transaction %d: ID = %d, Reward = %d, From = %d, To = %d, Value = %d, Age = %d",
-                        i + 1, t->id, t->reward, t->sender_id, t->receiver_id, t->value, t->age);
+    // Uma transação que já saiu da pool não volta (os ids não se repetem): o bloco pode ser
+    // recusado já aqui, sem esperar pela sua vez
+    for (int i = 0; i < global_config.transactions_per_block; i++) {
+        if (!is_transaction_in_pool(block->transactions[i].id)) {
+            LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Transação %d não encontrada na pool.", block->transactions[i].id);
+            return -1;
         }
     }
+    return 0;
 }
 
-int validate_block(TransactionBlock* block) {
-    // 1. Verificar pow (a implementar)
+// Verificações que dependem da cadeia: só na thread principal, pela ordem dos blocos
+static int validate_block_state(TransactionBlock* block, int miner_id) {
+    account_batch.failed_tx = -1;
 
     // 2. Verificar se o bloco referencia corretamente o último bloco da blockchain
-    TransactionPool* pool = (TransactionPool*)tx_pool_ptr;
-
     // Verifica se o hash do bloco anterior é o mesmo que o ID do bloco atual na tx_pool
     char expected_previous_hash[HASH_SIZE];
-    snprintf(expected_previous_hash, HASH_SIZE, "%s", pool->current_block_hash);  
+    tx_pool_get_current_hash(tx_pool_ptr, expected_previous_hash);
 
     if (strcmp(block->previous_block_hash, expected_previous_hash) != 0) {
-        log_message("ERROR: Bloco não está corretamente encadeado com o último bloco da tx_pool.");
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Bloco não está corretamente encadeado com o último bloco da tx_pool.");
         return -1;  // Indica que a validação falhou
     }
 
-    // 3. Verificar se as transações ainda estão presentes na tx_pool
+    // 3. Verificar se as transações ainda estão na tx_pool, reservadas pelo miner do bloco
+    // (os blocos anteriores na janela podem ter retirado alguma depois do worker a ver)
     for (int i = 0; i < global_config.transactions_per_block; i++) {
-        if (!is_transaction_in_pool(block->transactions[i].id)) {  // Acesse com o índice do array
-            log_message("ERROR: Transação %d não encontrada na pool.", block->transactions[i].id);
+        int slot = tx_pool_find(tx_pool_ptr, block->transactions[i].id);
+        if (slot < 0) {
+            LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Transação %d não encontrada na pool.", block->transactions[i].id);
             return -1;  // Indica que a validação falhou
         }
+        if (tx_pool_slot_owner(tx_pool_ptr, slot) != miner_id) {
+            LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Transação %d não está reservada pelo miner %d.", block->transactions[i].id, miner_id);
+            return -1;
+        }
+    }
+
+    // 4. Aplicar as transferências à tabela de saldos: descobertos e gastos duplos rejeitam o
+    // bloco (já desfeito). Se o commit falhar, o bloco é desfeito em decide_block
+    int applied = account_apply_block(account_table, block, global_config.transactions_per_block, &account_batch);
+    if (applied == ACCOUNT_TABLE_FULL) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Bloco %s rejeitado: tabela de contas cheia (aumentar ACCOUNT_TABLE_SIZE); "
+                  "as transações voltam à pool.", block->txb_id);
+        return -1;
+    }
+    if (applied != 0) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Bloco %s rejeitado pelos saldos das contas.", block->txb_id);
+        return -1;
     }
 
     // Se todas as verificações passarem, a validação foi bem-sucedida
-    log_message("VALIDATOR: Bloco validado com sucesso (ID: %s)", block->txb_id);
+    LOG_INFO(LOG_CAT_VALIDATOR, "VALIDATOR: Bloco validado com sucesso (ID: %s)", block->txb_id);
     return 0;  // Sucesso
 }
 
+// Acrescenta o bloco à blockchain, avança o hash atual e retira as transações da pool.
+// O validator é o único processo que escreve na blockchain e no hash atual.
+static int commit_block(const TransactionBlock* block, int miner_id) {
+    Blockchain* chain = blockchain_ptr;
+    char block_hash[HASH_SIZE];
+
+    if (ledger_append(chain, block) != 0) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Failed to append block %s to the ledger", block->txb_id);
+        return -1;
+    }
+
+    account_commit(account_table, &account_batch);
+    pow_block_hash(block, block_hash);
+    tx_pool_set_current_hash(tx_pool_ptr, block_hash);
+
+    uint64_t committed_ns = trace_now_ns();
+    for (int i = 0; i < global_config.transactions_per_block; i++) {
+        int slot = tx_pool_find(tx_pool_ptr, block->transactions[i].id);
+        if (slot >= 0 && tx_pool_remove(tx_pool_ptr, slot, miner_id) == 0) {
+            trace_tx(TRACE_TX_COMMIT, block->transactions[i].id, slot, miner_id, 0);
+            STATS_LATENCY(LAT_END_TO_END, block->transactions[i].timestamp, committed_ns);
+        }
+    }
+
+    STATS_ADD(blocks_validated, 1);
+    trace_block(TRACE_BLOCK_COMMIT, block->txb_id, miner_id, block->nonce, (int)(chain->block_count - 1));
+    LOG_INFO(LOG_CAT_VALIDATOR, "VALIDATOR: Block %s committed at height %llu (hash %s)",
+                block->txb_id, (unsigned long long)(chain->block_count - 1), block_hash);
+    return 0;
+}
+
+// Bloco rejeitado: as transações reservadas pelo miner voltam a estar disponíveis.
+// As que já pertencem a outro miner (reserva expirada) não são tocadas. A transferência
+// inválida (failed_tx) sai da pool; devolvê-la faria os miners minerar o mesmo bloco inválido.
+// Com a tabela de contas cheia não há culpada e todas voltam
+static void release_block_transactions(const TransactionBlock* block, int miner_id) {
+    for (int i = 0; i < global_config.transactions_per_block; i++) {
+        int slot = tx_pool_find(tx_pool_ptr, block->transactions[i].id);
+        if (slot >= 0 && i == account_batch.failed_tx) {
+            if (tx_pool_remove(tx_pool_ptr, slot, miner_id) == 0) {
+                LOG_INFO(LOG_CAT_VALIDATOR, "VALIDATOR: Transaction %d dropped (overdraft or negative value)",
+                         block->transactions[i].id);
+            }
+        } else if (slot >= 0) {
+            trace_tx(TRACE_TX_RELEASE, block->transactions[i].id, slot, miner_id, 0);
+            tx_pool_release(tx_pool_ptr, slot, miner_id);
+        }
+    }
+}
+
 void cleanup_validator_resources() {
     // Detach from shared memory
     if (tx_pool_ptr != NULL) {
-        munmap(tx_pool_ptr, sizeof(TransactionPool) + sizeof(Transaction) * global_config.pool_size);
+        munmap(tx_pool_ptr, tx_pool_size(global_config.pool_size, global_config.tx_pool_shards));
+    }
+    // Pára a thread de arquivo e faz o último group commit; o footer fica para o controller
+    ledger_close(blockchain_ptr, 0);
+    blockchain_ptr = NULL;
+    close_block_ring_memory(block_ring);
+    account_batch_free(&account_batch);
+    account_table_close(account_table, 0);
+    LOG_INFO(LOG_CAT_VALIDATOR, "VALIDATOR: resources cleaned");
+}
+
+// Worker: verifica lotes de até VALIDATOR_BATCH blocos; o PoW do lote é um só
+// pow_verify_batch (as compressões dos cabeçalhos avançam juntas no kernel multi-buffer)
+static void* verify_worker_main(void* arg) {
+    (void)arg;
+    const TransactionBlock* blocks[VALIDATOR_BATCH];
+    int pow_ok[VALIDATOR_BATCH];
+    int verdicts[VALIDATOR_BATCH];
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);   // Os sinais ficam para a thread principal do validator
+
+    pthread_mutex_lock(&window.lock);
+    while (1) {
+        while (!window.stopping && window.next == window.tail) {
+            pthread_cond_wait(&window.pending, &window.lock);
+        }
+        if (window.stopping) {
+            break;
+        }
+        uint64_t first = window.next;
+        int n = window.tail - first < VALIDATOR_BATCH ? (int)(window.tail - first) : VALIDATOR_BATCH;
+        window.next += (uint64_t)n;
+        for (int i = 0; i < n; i++) {
+            blocks[i] = block_ring_slot_block(window.jobs[(first + i) % BLOCK_RING_SLOTS].slot);
+        }
+        pthread_mutex_unlock(&window.lock);
+
+        // Os jobs [first, first + n) só são reutilizados depois de decididos
+        pow_verify_batch(blocks, n, global_config.pow_difficulty, pow_ok);
+        for (int i = 0; i < n; i++) {
+            verdicts[i] = verify_block_contents(blocks[i], pow_ok[i]);
+        }
+
+        pthread_mutex_lock(&window.lock);
+        for (int i = 0; i < n; i++) {
+            ValidationJob* job = &window.jobs[(first + i) % BLOCK_RING_SLOTS];
+            job->verdict = verdicts[i];
+            job->verified = 1;
+        }
+        pthread_cond_signal(&window.verified);
     }
-    log_message("VALIDATOR: resources cleaned");
+    pthread_mutex_unlock(&window.lock);
+    return NULL;
+}
 
-    // Close other resources (e.g., semaphores) if the validator opened them
+static void start_verify_workers(int count) {
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&verify_workers[i], NULL, verify_worker_main, NULL) != 0) {
+            break;
+        }
+        verify_worker_count++;
+    }
+    if (verify_worker_count == 0) {
+        LOG_ERROR(LOG_CAT_VALIDATOR, "ERROR: Validator failed to start its verification threads");
+        exit(EXIT_FAILURE);
+    }
+    LOG_INFO(LOG_CAT_VALIDATOR, "VALIDATOR: %d verification thread(s), batches of up to %d blocks",
+             verify_worker_count, VALIDATOR_BATCH);
 }
-// Continuously listen for blocks from the miner
 
-/*
-void listen_for_blocks(Config* config) {
-    (void)config;
-    log_message("VALIDATOR: Waiting for blocks from miner...");
+// Pára os workers; os blocos que ficaram na janela por decidir são descartados, como os
+// que ainda estão no ring
+static void stop_verify_workers(void) {
+    pthread_mutex_lock(&window.lock);
+    window.stopping = 1;
+    pthread_cond_broadcast(&window.pending);
+    pthread_mutex_unlock(&window.lock);
+    for (int i = 0; i < verify_worker_count; i++) {
+        pthread_join(verify_workers[i], NULL);
+    }
+    verify_worker_count = 0;
 
-    // Abrir FIFO para leitura (só abrir uma vez)
-    open_fifo_for_reading();
-    signal(SIGINT, handle_sigint_validator);
+    for (; window.head != window.tail; window.head++) {
+        block_ring_release(block_ring, window.jobs[window.head % BLOCK_RING_SLOTS].slot);
+    }
+}
 
-    // Continuamente receber blocos até que uma condição de parada seja atendida
-    while (running_validator) {
-        // Log de progresso para confirmar que o validador está aguardando por blocos
-        log_message("VALIDATOR: Waiting for the next block...");
-
-        // Receber um bloco do minerador
-        TransactionBlock block;
-        receive_block_from_miner(&block);
-
-        // Verificar se o bloco foi validado
-        if (validate_block(&block) == 0) {
-            // Lógica do que fazer caso o bloco seja validado
-            log_message("VALIDATOR: Block validated successfully (ID: %s)", block.txb_id);
-            // Exemplo: Adicionar o bloco à blockchain ou processar mais
-            // add_block_to_blockchain(&block);
-        } else {
-            // Lógica para se o bloco não for validado
-            log_message("VALIDATOR: Block validation failed (ID: %s)", block.txb_id);
-            // Exemplo: Rejeitar o bloco ou pedir para o minerador corrigir
-            // reject_block(&block);
+// Consome os slots publicados até a janela encher. Só espera (futex) se não houver nada
+// na janela; com blocos em verificação volta logo para os decidir
+static void fill_window(int timeout_ms) {
+    while (window.tail - window.head < BLOCK_RING_SLOTS) {
+        int wait_ms = window.tail == window.head ? timeout_ms : 0;
+        BlockRingSlot* slot = block_ring_consume(block_ring, wait_ms);
+        if (slot == NULL) {
+            return;
         }
 
-        // Opcional: Adicionar um pequeno atraso para evitar sobrecarga de logs ou uso excessivo de CPU
-        sleep(1);  // Descomente se necessário para reduzir a carga
+        pthread_mutex_lock(&window.lock);
+        window.jobs[window.tail % BLOCK_RING_SLOTS] = (ValidationJob){ .slot = slot, .verified = 0, .verdict = -1 };
+        window.tail++;
+        pthread_cond_signal(&window.pending);
+        pthread_mutex_unlock(&window.lock);
     }
+}
 
-    // Fechar o FIFO quando terminar (neste caso, o programa pode ser finalizado ou parado)
-    close_fifo();
-    cleanup_validator_resources();
+// Decide um bloco já verificado pelos workers: o resto da validação, commit ou rejeição
+static void decide_block(BlockRingSlot* slot, int verdict) {
+    TransactionBlock* block = block_ring_slot_block(slot);
+    print_block(block);
+
+    account_batch.failed_tx = -1;
+    int valid = verdict == 0 && validate_block_state(block, slot->miner_id) == 0;
+    uint64_t verdict_ns = trace_now_ns();
+    STATS_LATENCY(LAT_VALIDATION, slot->publish_ns, verdict_ns);
+
+    if (valid && commit_block(block, slot->miner_id) == 0) {
+        STATS_LATENCY(LAT_COMMIT, verdict_ns, trace_now_ns());
+    } else {
+        LOG_INFO(LOG_CAT_VALIDATOR, "VALIDATOR: Block validation failed (ID: %s)", block->txb_id);
+        trace_block(TRACE_BLOCK_REJECT, block->txb_id, slot->miner_id, block->nonce, 0);
+        STATS_ADD(blocks_rejected, 1);
+        account_rollback(account_table, &account_batch);   // Vazio se a validação falhou antes dos saldos
+        release_block_transactions(block, slot->miner_id);
+    }
+
+    block_ring_release(block_ring, slot);
 }
-*/
 
+// Decide, por ordem, os blocos da cabeça da janela que já foram verificados. Se a cabeça
+// ainda está num worker espera por ela no máximo timeout_ms
+static void decide_verified_blocks(int timeout_ms) {
+    int waited = 0;
+
+    pthread_mutex_lock(&window.lock);
+    while (window.head != window.tail) {
+        ValidationJob* job = &window.jobs[window.head % BLOCK_RING_SLOTS];
+        if (!job->verified) {
+            if (waited || !running_validator) {
+                break;
+            }
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)timeout_ms * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&window.verified, &window.lock, &deadline);
+            waited = 1;
+            continue;
+        }
+
+        BlockRingSlot* slot = job->slot;
+        int verdict = job->verdict;
+        pthread_mutex_unlock(&window.lock);
+        decide_block(slot, verdict);
+        pthread_mutex_lock(&window.lock);
+        window.head++;
+    }
+    pthread_mutex_unlock(&window.lock);
+}
+
+// Continuously consume blocks published by the miners in the shared ring
 void listen_for_blocks(Config* config) {
     (void)config;
 
     signal(SIGINT, handle_sigint_validator);
 
-    // Continuamente receber blocos até que uma condição de parada seja atendida
+    open_tx_pool_memory();
+    blockchain_ptr = ledger_attach(LEDGER_FILE, &global_config);
+    archive_start(blockchain_ptr);   // Blocos que saem da janela vão para o arquivo em background
+    block_ring = open_block_ring_memory();
+    account_table = account_table_attach();
+    account_batch_attach(&account_batch, account_table);   // O undo de cada bloco fica no ficheiro da tabela
+    start_verify_workers(global_config.validator_threads);
+
+    LOG_INFO(LOG_CAT_VALIDATOR, "VALIDATOR: Waiting for blocks from miner...");
+
+    time_t last_reap = time(NULL);
+
     while (running_validator) {
-        // Log de progresso para confirmar que o validador está aguardando por blocos
-        log_message("VALIDATOR: Waiting for the next block...");
-        sleep(10);
+        // Reservas de miners que morreram ou ficaram presos voltam à pool (no máximo 1x/s)
+        time_t now = time(NULL);
+        if (now != last_reap) {
+            int reaped = tx_pool_reap_expired(tx_pool_ptr);
+            if (reaped > 0) {
+                LOG_INFO(LOG_CAT_VALIDATOR, "VALIDATOR: %d expired transaction lease(s) returned to the pool", reaped);
+            }
+            last_reap = now;
+        }
+
+        // Um group commit incompleto não espera mais do que LEDGER_SYNC_INTERVAL_MS
+        ledger_sync_if_due(blockchain_ptr);
+
+        // Acorda por futex quando um miner publica um slot (timeout para ver o SIGINT);
+        // os blocos consumidos são verificados pelos workers e decididos aqui, por ordem
+        int timeout_ms = ledger_has_pending(blockchain_ptr) ? LEDGER_SYNC_INTERVAL_MS : 1000;
+        fill_window(timeout_ms);
+        decide_verified_blocks(timeout_ms);
     }
 
-    // Fechar o FIFO quando terminar (neste caso, o programa pode ser finalizado ou parado)
+    stop_verify_workers();
+    cleanup_validator_resources();
 }
@@ -6,7 +6,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 
-void receive_block_from_miner(TransactionBlock* block); 
+#define VALIDATOR_MAX_THREADS 16   // Workers de verificação (VALIDATOR_THREADS)
+
+void print_block(const TransactionBlock* block);
+int is_transaction_in_pool(int tx_id);
 void listen_for_blocks(Config* config); 
 
 #endif // VALIDATOR_H